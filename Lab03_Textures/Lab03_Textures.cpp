@@ -229,6 +229,7 @@ int main(void)
     glDeleteBuffers(1, &VBO);
     glDeleteVertexArrays(1, &VAO);
     glDeleteProgram(shaderID);
+    TextureCache::shared().clear();
 
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
@@ -319,6 +319,7 @@ int main(void)
     glDeleteBuffers(1, &EBO);
     glDeleteBuffers(1, &uvBuffer);
     glDeleteProgram(shaderID);
+    TextureCache::shared().clear();
 
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
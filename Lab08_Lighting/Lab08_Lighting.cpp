@@ -8,7 +8,11 @@
 #include <common/texture.hpp>
 #include <common/maths.hpp>
 #include <common/camera.hpp>
+#include <common/geometrypool.hpp>
+#include <common/globject.hpp>
 #include <common/model.hpp>
+#include <common/archive.hpp>
+#include <common/assetmanager.hpp>
 
 // Function prototypes
 void keyboardInput(GLFWwindow *window);
@@ -105,21 +109,43 @@ int main( void )
     glfwPollEvents();
     glfwSetCursorPos(window, 1024 / 2, 768 / 2);
     
+    // Read assets from the lab's archive if one has been packed
+    AssetArchive archive;
+    if (archive.open("assets.pak"))
+        AssetArchive::mount(&archive);
+    
     // Compile shader program
     unsigned int shaderID, lightShaderID;
     //shaderID      = LoadShaders("vertexShader.glsl", "fragmentShader.glsl");
     shaderID = LoadShaders("vertexShader.glsl", "multipleLightsFragmentShader.glsl");
     lightShaderID = LoadShaders("lightVertexShader.glsl", "lightFragmentShader.glsl");
+    GLProgram shader(shaderID), lightShader(lightShaderID);
     
     // Activate shader
     glUseProgram(shaderID);
     
-    // Load models
-    Model teapot("../assets/teapot.obj");
-    Model sphere("../assets/sphere.obj");
+    // Load models, packing them into one set of buffers so switching
+    // between them doesn't rebind the vertex array. The pool is declared
+    // first so that it outlives every model placed in it.
+    GeometryPool pool(VertexLayout::standard(), true);
+    AssetManager assets;
+    ModelOptions teapotOptions;
+    teapotOptions.pool = &pool;
+    std::shared_ptr<Model> teapotModel = assets.model("../assets/teapot.obj", teapotOptions);
+    ModelOptions lightOptions;
+    lightOptions.positionStream = true;
+    lightOptions.pool = &pool;
+    std::shared_ptr<Model> sphereModel = assets.model("../assets/sphere.obj", lightOptions);
+    Model &teapot = *teapotModel;
+    Model &sphere = *sphereModel;
     
     // Load the textures
-    teapot.addTexture("../assets/blue.bmp", "diffuse");
+    teapot.addTexture(assets.texture("../assets/blue.bmp"), "diffuse");
+    
+    // Reload the assets and shaders when their files change
+    assets.enableHotReload();
+    assets.watchShaders(shaderID, "vertexShader.glsl", "multipleLightsFragmentShader.glsl");
+    assets.watchShaders(lightShaderID, "lightVertexShader.glsl", "lightFragmentShader.glsl");
     
     // Use wireframe rendering (comment out to turn off)
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -183,6 +209,11 @@ int main( void )
         object.angle = Maths::radians(20.0f * i);
         objects.push_back(object);
     }
+    
+    // Vertex array binds, reported once a second
+    unsigned int frames = 0;
+    float reportTime = 0.0f;
+    GLObjects::vertexArrayBinds();
 
 
     // Render loop
@@ -193,6 +224,9 @@ int main( void )
         deltaTime    = time - previousTime;
         previousTime = time;
         
+        // Reload assets whose files have changed
+        assets.reload();
+        
         // Get inputs
         keyboardInput(window);
         mouseInput(window);
@@ -272,6 +306,10 @@ int main( void )
             glm::mat4 MVP = camera.projection * MV;
             glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
             glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &MV[0][0]);
+            
+            // Send the normal matrix so the shader doesn't invert MV per vertex
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
+            glUniformMatrix3fv(glGetUniformLocation(shaderID, "normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
 
             // Draw the model
             teapot.draw(shaderID);
@@ -316,7 +354,16 @@ int main( void )
             glUniform3fv(glGetUniformLocation(lightShaderID, "lightColour"), 1, &lightSources[i].colour[0]);
 
             // Draw light source
-            sphere.draw(lightShaderID);
+            sphere.drawDepth(lightShaderID);
+        }
+        
+        // Report the vertex array binds per frame
+        frames++;
+        if (time - reportTime >= 1.0f)
+        {
+            printf("Vertex array binds per frame: %.1f\n", float(GLObjects::vertexArrayBinds()) / frames);
+            frames     = 0;
+            reportTime = time;
         }
 
         // Swap buffers
@@ -324,9 +371,15 @@ int main( void )
         glfwPollEvents();
     }
     
-    // Cleanup
-    teapot.deleteBuffers();
-    glDeleteProgram(shaderID);
+    // Cleanup (models and textures are freed with their last handle)
+    assets.report();
+    pool.report();
+    teapotModel.reset();
+    sphereModel.reset();
+    pool.release();
+    shader.reset();
+    lightShader.reset();
+    GLObjects::report();
     
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
@@ -5,10 +5,12 @@ layout(location = 0) in vec3 position;
 
 // Uniforms
 uniform mat4 MVP;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 uniform mat4 MV;
 
 void main()
 {
     // Output vertex postion
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(positionOffset + positionScale * position, 1.0);
 }
@@ -13,16 +13,34 @@ out vec3 Normal;
 // Uniforms
 uniform mat4 MVP;
 uniform mat4 MV;
+uniform mat3 normalMatrix;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octahedralNormals;
+
+// Decode an octahedral encoded normal
+vec3 octDecode(vec2 e)
+{
+    vec3 n  = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x    += n.x >= 0.0 ? -t : t;
+    n.y    += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
+    // Decode the vertex attributes
+    vec3 vertexPosition = positionOffset + positionScale * position;
+    vec3 vertexNormal   = octahedralNormals ? octDecode(normal.xy) : normal;
+    
     // Output vertex position
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(vertexPosition, 1.0);
     
     // Output texture coordinates
     UV = uv;
     
     // Output view space fragment position and normal vector
-    fragmentPosition = vec3(MV * vec4(position, 1.0));
-    Normal           = mat3(transpose(inverse(MV))) * normal;
+    fragmentPosition = vec3(MV * vec4(vertexPosition, 1.0));
+    Normal           = normalMatrix * vertexNormal;
 }
\ No newline at end of file
@@ -8,7 +8,11 @@
 #include <common/texture.hpp>
 #include <common/maths.hpp>
 #include <common/camera.hpp>
+#include <common/assetloader.hpp>
+#include <common/assetmanager.hpp>
+#include <common/globject.hpp>
 #include <common/model.hpp>
+#include <common/archive.hpp>
 #include <common/light.hpp>
 
 // Function prototypes
@@ -90,26 +94,52 @@ int main( void )
     glfwPollEvents();
     glfwSetCursorPos(window, 1024 / 2, 768 / 2);
     
+    // Read assets from the lab's archive if one has been packed
+    AssetArchive archive;
+    if (archive.open("assets.pak"))
+        AssetArchive::mount(&archive);
+    
     // Compile shader program
     unsigned int shaderID, lightShaderID;
     shaderID      = LoadShaders("vertexShader.glsl", "fragmentShader.glsl");
     lightShaderID = LoadShaders("lightVertexShader.glsl", "lightFragmentShader.glsl");
+    GLProgram shader(shaderID), lightShader(lightShaderID);
     
     // Activate shader
     glUseProgram(shaderID);
     
-    // Load models
-    Model teapot("../assets/teapot.obj");
-    Model sphere("../assets/sphere.obj");
+    // Load the teapot in the background, drawing a cube until it is ready
+    AssetLoader loader;
+    AssetManager assets(&loader);
+    Model placeholder("../assets/cube.obj");
+    loader.setPlaceholder(&placeholder);
+    ModelOptions teapotOptions;
+    teapotOptions.lodLevels = { 0.5f, 0.25f, 0.1f };
+    teapotOptions.meshlets  = true;
+    std::shared_ptr<Model> teapotModel = assets.model("../assets/teapot.obj", teapotOptions);
+    ModelOptions lightOptions;
+    lightOptions.positionStream = true;
+    std::shared_ptr<Model> sphereModel = assets.model("../assets/sphere.obj", lightOptions);
+    Model &teapot = *teapotModel;
+    Model &sphere = *sphereModel;
     
     // Load the textures
-    teapot.addTexture("../assets/blue.bmp", "diffuse");
+    teapot.addTexture(assets.texture("../assets/blue.bmp"), "diffuse");
+    
+    // Reload the assets and shaders when their files change
+    assets.enableHotReload();
+    assets.watchShaders(shaderID, "vertexShader.glsl", "fragmentShader.glsl");
+    assets.watchShaders(lightShaderID, "lightVertexShader.glsl", "lightFragmentShader.glsl");
     
     // Define teapot object lighting properties
     teapot.ka = 0.2f;
     teapot.kd = 0.7f;
     teapot.ks = 1.0f;
     teapot.Ns = 20.0f;
+    placeholder.ka = 0.2f;
+    placeholder.kd = 0.7f;
+    placeholder.ks = 1.0f;
+    placeholder.Ns = 20.0f;
     
     // Add light sources
     Light lightSources;
@@ -157,6 +187,15 @@ int main( void )
         objects.push_back(object);
     }
     
+    // Meshlet culling totals, reported once a second
+    MeshletStats culled = {};
+    float reportTime = 0.0f;
+    
+    // Loading times
+    bool firstFrame = true;
+    float maxFrameTime = 0.0f;
+    previousTime = glfwGetTime();
+    
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
@@ -165,6 +204,19 @@ int main( void )
         deltaTime    = time - previousTime;
         previousTime = time;
         
+        // Reload assets whose files have changed
+        assets.reload();
+        
+        // Upload the assets that have finished loading
+        if (loader.pending() > 0)
+        {
+            maxFrameTime = glm::max(maxFrameTime, deltaTime);
+            loader.update();
+            if (loader.pending() == 0)
+                printf("Assets streamed in %.1f ms, longest frame %.1f ms, longest upload %.2f ms\n",
+                       1000.0f * time, 1000.0f * maxFrameTime, loader.maxUpdateTime);
+        }
+        
         // Get inputs
         keyboardInput(window);
         mouseInput(window);
@@ -198,9 +250,28 @@ int main( void )
             glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
             glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &MV[0][0]);
             
+            // Send the normal matrix so the shader doesn't invert MV per vertex
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
+            glUniformMatrix3fv(glGetUniformLocation(shaderID, "normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
+            
             // Draw the model
             if (objects[i].name == "teapot")
-                teapot.draw(shaderID);
+            {
+                teapot.draw(shaderID, MV, camera.projection);
+                culled.meshlets      += teapot.meshletStats.meshlets;
+                culled.frustumCulled += teapot.meshletStats.frustumCulled;
+                culled.coneCulled    += teapot.meshletStats.coneCulled;
+            }
+        }
+        
+        // Report the fraction of the meshlets culled
+        if (time - reportTime >= 1.0f && culled.meshlets > 0)
+        {
+            printf("Meshlets culled: %.1f%% outside the frustum, %.1f%% facing away\n",
+                   100.0f * culled.frustumCulled / culled.meshlets,
+                   100.0f * culled.coneCulled / culled.meshlets);
+            culled     = MeshletStats();
+            reportTime = time;
         }
         
         // Draw light sources
@@ -209,11 +280,22 @@ int main( void )
         // Swap buffers
         glfwSwapBuffers(window);
         glfwPollEvents();
+        
+        if (firstFrame)
+        {
+            printf("First frame after %.1f ms\n", 1000.0f * glfwGetTime());
+            firstFrame = false;
+        }
     }
     
-    // Cleanup
-    teapot.deleteBuffers();
-    glDeleteProgram(shaderID);
+    // Cleanup (models and textures are freed with their last handle)
+    assets.report();
+    teapotModel.reset();
+    sphereModel.reset();
+    placeholder.deleteBuffers();
+    shader.reset();
+    lightShader.reset();
+    GLObjects::report();
     
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
@@ -8,7 +8,10 @@
 #include <common/texture.hpp>
 #include <common/maths.hpp>
 #include <common/camera.hpp>
+#include <common/globject.hpp>
 #include <common/model.hpp>
+#include <common/archive.hpp>
+#include <common/assetmanager.hpp>
 #include <common/light.hpp>
 
 // Function prototypes
@@ -90,20 +93,38 @@ int main( void )
     glfwPollEvents();
     glfwSetCursorPos(window, 1024 / 2, 768 / 2);
     
+    // Read assets from the lab's archive if one has been packed
+    AssetArchive archive;
+    if (archive.open("assets.pak"))
+        AssetArchive::mount(&archive);
+    
     // Compile shader program
     unsigned int shaderID, lightShaderID;
     shaderID      = LoadShaders("vertexShader.glsl", "fragmentShader.glsl");
     lightShaderID = LoadShaders("lightVertexShader.glsl", "lightFragmentShader.glsl");
+    GLProgram shader(shaderID), lightShader(lightShaderID);
     
     // Activate shader
     glUseProgram(shaderID);
     
     // Load models
-    Model cube("../assets/cube.obj");
-    Model sphere("../assets/sphere.obj");
+    AssetManager assets;
+    ModelOptions cubeOptions;
+    cubeOptions.vertexLayout = VertexLayout::standard().add(AttributeTangent, FormatOctTangent16);
+    std::shared_ptr<Model> cubeModel = assets.model("../assets/cube.obj", cubeOptions);
+    ModelOptions lightOptions;
+    lightOptions.positionStream = true;
+    std::shared_ptr<Model> sphereModel = assets.model("../assets/sphere.obj", lightOptions);
+    Model &cube   = *cubeModel;
+    Model &sphere = *sphereModel;
     
     // Load the textures
-    cube.addTexture("../assets/crate.jpg", "diffuse");
+    cube.addTexture(assets.texture("../assets/crate.jpg"), "diffuse");
+    
+    // Reload the assets and shaders when their files change
+    assets.enableHotReload();
+    assets.watchShaders(shaderID, "vertexShader.glsl", "fragmentShader.glsl");
+    assets.watchShaders(lightShaderID, "lightVertexShader.glsl", "lightFragmentShader.glsl");
     
     // Define cube object lighting properties
     cube.ka = 1.0f;
@@ -151,6 +172,9 @@ int main( void )
         deltaTime    = time - previousTime;
         previousTime = time;
         
+        // Reload assets whose files have changed
+        assets.reload();
+        
         // Get inputs
         keyboardInput(window);
         mouseInput(window);
@@ -187,6 +211,10 @@ int main( void )
             glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
             glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &MV[0][0]);
             
+            // Send the normal matrix so the shader doesn't invert MV per vertex
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
+            glUniformMatrix3fv(glGetUniformLocation(shaderID, "normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
+            
             // Draw the model
             if (objects[i].name == "cube")
                 cube.draw(shaderID);
@@ -200,9 +228,13 @@ int main( void )
         glfwPollEvents();
     }
     
-    // Cleanup
-    cube.deleteBuffers();
-    glDeleteProgram(shaderID);
+    // Cleanup (models and textures are freed with their last handle)
+    assets.report();
+    cubeModel.reset();
+    sphereModel.reset();
+    shader.reset();
+    lightShader.reset();
+    GLObjects::report();
     
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
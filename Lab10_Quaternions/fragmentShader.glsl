@@ -43,8 +43,10 @@ vec3 spotLight(vec3 lightPosition, vec3 direction, vec3 lightColour,
 
 vec3 directionalLight(vec3 lightDirection, vec3 lightColour);
 
-// Get the normal vector from the normal map
-vec3 Normal = normalize(2.0 * vec3(texture(normalMap, UV)) - 1.0);
+// Get the normal vector from the normal map. Only x and y are read and z is
+// rebuilt from them, as BC5 normal maps from texcompress store just x and y.
+vec2 NormalXY = 2.0 * texture(normalMap, UV).rg - 1.0;
+vec3 Normal = vec3(NormalXY, sqrt(max(1.0 - dot(NormalXY, NormalXY), 0.0)));
 
 void main ()
 {
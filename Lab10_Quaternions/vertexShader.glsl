@@ -6,8 +6,7 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 uv;
 layout(location = 2) in vec3 normal;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec3 bitangent;
+layout(location = 3) in vec4 tangent;     // bitangent sign in w
 
 // Outputs
 out vec2 UV;
@@ -31,27 +30,45 @@ struct Light
 // Uniforms
 uniform mat4 MVP;
 uniform mat4 MV;
+uniform mat3 normalMatrix;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octahedralNormals;
+uniform bool octahedralTangents;
 uniform Light lightSources[maxLights];
 
+// Decode an octahedral encoded normal
+vec3 octDecode(vec2 e)
+{
+    vec3 n  = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x    += n.x >= 0.0 ? -t : t;
+    n.y    += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
+    // Decode the vertex attributes
+    vec3 vertexPosition = positionOffset + positionScale * position;
+    vec3 vertexNormal   = octahedralNormals ? octDecode(normal.xy) : normal;
+    vec4 vertexTangent  = octahedralTangents ? vec4(octDecode(tangent.xy), tangent.z) : tangent;
+    
     // Output vertex position
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = MVP * vec4(vertexPosition, 1.0);
     
     // Output texture co-ordinates
     UV = uv;
     
     // Calculate the TBN matrix that transforms view space to tangent space
-    mat3 invMV = transpose(inverse(mat3(MV)));
-    vec3 t     = normalize(invMV * tangent);
-    //vec3 b     = normalize(invMV * bitangent);
-    vec3 n     = normalize(invMV * normal);
+    vec3 t     = normalize(mat3(MV) * vertexTangent.xyz);
+    vec3 n     = normalize(normalMatrix * vertexNormal);
     t = normalize(t - dot(t, n) * n);
-    vec3 b     = cross(n, t);
+    vec3 b     = vertexTangent.w * cross(n, t);
     mat3 TBN   = transpose(mat3(t, b, n));
     
     // Output tangent space fragment position, light positions and directions
-    fragmentPosition = TBN * vec3(MV * vec4(position, 1.0));
+    fragmentPosition = TBN * vec3(MV * vec4(vertexPosition, 1.0));
     
     for (int i = 0; i < maxLights; i++)
     {
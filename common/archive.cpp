@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+
+#include <common/archive.hpp>
+#include <common/lz.hpp>
+#include <common/threadpool.hpp>
+
+namespace
+{
+    const char magic[4] = { 'A', 'P', 'A', 'K' };
+    const uint32_t version = 1;
+
+    // Entry data is aligned so mapped files can be used in place, like the
+    // blocks of a mesh cache
+    const uint64_t dataAlignment = 64;
+
+    AssetArchive *mountedArchive = NULL;
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + dataAlignment - 1) & ~(dataAlignment - 1);
+    }
+
+    uint64_t blockLength(const ArchiveEntry &entry, uint32_t blockSize, uint32_t block)
+    {
+        return std::min<uint64_t>(blockSize, entry.size - uint64_t(block) * blockSize);
+    }
+
+    bool readMounted(const char *name, std::string &contents)
+    {
+        const ArchiveEntry *entry = mountedArchive->find(name);
+        if (entry == NULL)
+            return false;
+        contents.resize(static_cast<size_t>(entry->size));
+        return mountedArchive->read(*entry, &contents[0]);
+    }
+
+    // File being packed
+    struct PackFile
+    {
+        std::string name;
+        std::string path;
+        bool operator<(const PackFile &other) const { return name < other.name; }
+    };
+}
+
+bool AssetArchive::open(const char *path)
+{
+    close();
+    if (!mapping.map(path) || mapping.size() < sizeof(ArchiveHeader))
+    {
+        mapping.close();
+        return false;
+    }
+
+    // Check the table of contents describes data that is actually in the file
+    const ArchiveHeader *candidate = reinterpret_cast<const ArchiveHeader *>(mapping.data());
+    uint64_t size = mapping.size();
+    if (memcmp(candidate->magic, magic, sizeof(magic)) != 0 || candidate->version != version ||
+        candidate->blockSize == 0 || candidate->entryOffset % sizeof(uint64_t) != 0 ||
+        candidate->entryOffset + uint64_t(candidate->entryCount) * sizeof(ArchiveEntry) > candidate->nameOffset ||
+        candidate->nameOffset > candidate->dataOffset || candidate->dataOffset > size)
+    {
+        mapping.close();
+        return false;
+    }
+    const ArchiveEntry *table = reinterpret_cast<const ArchiveEntry *>(mapping.data() + candidate->entryOffset);
+    const char *nameBlock = mapping.data() + candidate->nameOffset;
+    uint64_t nameSize = candidate->dataOffset - candidate->nameOffset;
+    for (uint32_t i = 0; i < candidate->entryCount; i++)
+    {
+        const ArchiveEntry &entry = table[i];
+        if (uint64_t(entry.nameOffset) + entry.nameLength >= nameSize || nameBlock[entry.nameOffset + entry.nameLength] != '\0' ||
+            entry.offset < candidate->dataOffset || entry.offset + entry.storedSize > size ||
+            (entry.blockCount == 0 && entry.storedSize != entry.size) ||
+            (entry.blockCount != 0 && entry.blockCount != (entry.size + candidate->blockSize - 1) / candidate->blockSize))
+        {
+            mapping.close();
+            return false;
+        }
+    }
+
+    header  = candidate;
+    entries = table;
+    names   = nameBlock;
+    return true;
+}
+
+void AssetArchive::close()
+{
+    if (mountedArchive == this)
+        mount(NULL);
+    mapping.close();
+    header  = NULL;
+    entries = NULL;
+    names   = NULL;
+}
+
+const ArchiveEntry *AssetArchive::find(const char *path) const
+{
+    if (header == NULL)
+        return NULL;
+
+    // Binary search the sorted table in place
+    std::string name = normalise(path);
+    uint32_t first = 0, last = header->entryCount;
+    while (first < last)
+    {
+        uint32_t middle = first + (last - first) / 2;
+        int order = strcmp(names + entries[middle].nameOffset, name.c_str());
+        if (order == 0)
+            return &entries[middle];
+        if (order < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return NULL;
+}
+
+bool AssetArchive::open(const char *path, MappedFile &file) const
+{
+    const ArchiveEntry *entry = find(path);
+    if (entry == NULL)
+        return false;
+
+    file.close();
+    if (entry->blockCount == 0)
+        file.fileData = mapping.data() + entry->offset;
+    else
+    {
+        file.buffer.resize(static_cast<size_t>(entry->size));
+        if (!read(*entry, file.buffer.data()))
+        {
+            printf("Archive entry %s is corrupt.\n", name(*entry));
+            file.close();
+            return false;
+        }
+        file.fileData = file.buffer.data();
+    }
+    file.fileSize = static_cast<size_t>(entry->size);
+    file.opened   = true;
+    return true;
+}
+
+bool AssetArchive::read(const ArchiveEntry &entry, void *out) const
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(mapping.data() + entry.offset);
+    if (entry.blockCount == 0)
+    {
+        memcpy(out, data, static_cast<size_t>(entry.size));
+        return true;
+    }
+
+    // Check the block table, copying it out as it needn't be aligned
+    uint64_t tableSize = uint64_t(entry.blockCount) * sizeof(uint64_t);
+    if (tableSize > entry.storedSize)
+        return false;
+    std::vector<uint64_t> ends(entry.blockCount);
+    memcpy(ends.data(), data, static_cast<size_t>(tableSize));
+    for (uint32_t i = 0; i < entry.blockCount; i++)
+    {
+        if (ends[i] < (i > 0 ? ends[i - 1] : 0) || ends[i] > entry.storedSize - tableSize)
+            return false;
+    }
+
+    // Decompress the blocks in parallel, each into its own part of out
+    const unsigned char *blocks = data + tableSize;
+    uint32_t blockSize = header->blockSize;
+    std::atomic<bool> valid(true);
+    ThreadPool::shared().parallelFor(entry.blockCount, [&](unsigned int i)
+    {
+        uint64_t begin  = i > 0 ? ends[i - 1] : 0;
+        uint64_t stored = ends[i] - begin;
+        uint64_t length = blockLength(entry, blockSize, i);
+        unsigned char *target = static_cast<unsigned char *>(out) + uint64_t(i) * blockSize;
+        if (stored == length)
+            memcpy(target, blocks + begin, static_cast<size_t>(length));
+        else if (!Lz::decompress(blocks + begin, static_cast<size_t>(stored), target, static_cast<size_t>(length)))
+            valid = false;
+    });
+    return valid;
+}
+
+void AssetArchive::mount(AssetArchive *archive)
+{
+    mountedArchive  = archive;
+    archiveReader() = archive != NULL ? readMounted : NULL;
+}
+
+AssetArchive *AssetArchive::mounted()
+{
+    return mountedArchive;
+}
+
+std::string AssetArchive::normalise(const char *path)
+{
+    std::string name(path);
+    std::replace(name.begin(), name.end(), '\\', '/');
+    while (name.compare(0, 2, "./") == 0)
+        name.erase(0, 2);
+    return name;
+}
+
+bool AssetArchive::pack(const char *path, const std::vector<std::string> &files, bool compress,
+                        unsigned int blockSize)
+{
+    // Sort the files by name so they can be binary searched
+    std::vector<PackFile> sorted(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        sorted[i].path = files[i];
+        sorted[i].name = normalise(files[i].c_str());
+    }
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 1; i < sorted.size(); i++)
+    {
+        if (sorted[i].name == sorted[i - 1].name)
+        {
+            printf("%s is packed twice.\n", sorted[i].name.c_str());
+            return false;
+        }
+    }
+
+    // Lay out the header, table of contents and names, then the data
+    ArchiveHeader header = {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version     = version;
+    header.entryCount  = static_cast<uint32_t>(sorted.size());
+    header.blockSize   = blockSize;
+    header.entryOffset = sizeof(ArchiveHeader);
+    header.nameOffset  = header.entryOffset + sorted.size() * sizeof(ArchiveEntry);
+    std::vector<ArchiveEntry> entries(sorted.size());
+    std::string nameBlock;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        entries[i].nameOffset = static_cast<uint32_t>(nameBlock.size());
+        entries[i].nameLength = static_cast<uint32_t>(sorted[i].name.size());
+        nameBlock.append(sorted[i].name.c_str(), sorted[i].name.size() + 1);
+    }
+    header.dataOffset = alignUp(header.nameOffset + nameBlock.size());
+
+    // Write to a temporary file and rename it so a failed pack doesn't leave
+    // a broken archive behind
+    std::string temporaryPath = std::string(path) + ".tmp";
+    FILE *out = fopen(temporaryPath.c_str(), "wb");
+    if (out == NULL)
+        return false;
+
+    bool written = true;
+    uint64_t offset = header.dataOffset;
+    for (size_t i = 0; i < sorted.size() && written; i++)
+    {
+        MappedFile file;
+        struct stat info;
+        if (!file.map(sorted[i].path.c_str()) || stat(sorted[i].path.c_str(), &info) != 0)
+        {
+            printf("Couldn't read %s.\n", sorted[i].path.c_str());
+            written = false;
+            break;
+        }
+        ArchiveEntry &entry = entries[i];
+        entry.offset     = offset;
+        entry.size       = file.size();
+        entry.storedSize = file.size();
+        entry.time       = static_cast<int64_t>(info.st_mtime);
+        entry.blockCount = 0;
+
+        // Compress the blocks in parallel, storing any that don't shrink as
+        // they are, and keep the result if it saves at least 1/16 of the file
+        uint32_t blockCount = static_cast<uint32_t>((entry.size + blockSize - 1) / blockSize);
+        std::vector<std::vector<unsigned char> > blocks(compress ? blockCount : 0);
+        ThreadPool::shared().parallelFor(static_cast<unsigned int>(blocks.size()), [&](unsigned int block)
+        {
+            const char *begin = file.data() + uint64_t(block) * blockSize;
+            size_t length = static_cast<size_t>(blockLength(entry, blockSize, block));
+            Lz::compress(begin, length, blocks[block]);
+            if (blocks[block].size() >= length)
+                blocks[block].assign(begin, begin + length);
+        });
+        uint64_t storedSize = uint64_t(blocks.size()) * sizeof(uint64_t);
+        for (size_t block = 0; block < blocks.size(); block++)
+            storedSize += blocks[block].size();
+
+        fseek(out, static_cast<long>(offset), SEEK_SET);
+        if (!blocks.empty() && storedSize + entry.size / 16 < entry.size)
+        {
+            std::vector<uint64_t> ends(blockCount);
+            for (uint32_t block = 0; block < blockCount; block++)
+                ends[block] = (block > 0 ? ends[block - 1] : 0) + blocks[block].size();
+            written = fwrite(ends.data(), sizeof(uint64_t), ends.size(), out) == ends.size();
+            for (uint32_t block = 0; block < blockCount && written; block++)
+                written = fwrite(blocks[block].data(), 1, blocks[block].size(), out) == blocks[block].size();
+            entry.storedSize = storedSize;
+            entry.blockCount = blockCount;
+        }
+        else if (entry.size > 0)
+            written = fwrite(file.data(), 1, file.size(), out) == file.size();
+        offset = alignUp(offset + entry.storedSize);
+    }
+
+    // Then the table of contents at the front
+    if (written)
+    {
+        fseek(out, 0, SEEK_SET);
+        written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  fwrite(entries.data(), sizeof(ArchiveEntry), entries.size(), out) == entries.size() &&
+                  fwrite(nameBlock.data(), 1, nameBlock.size(), out) == nameBlock.size();
+    }
+    written = fclose(out) == 0 && written;
+    if (!written)
+    {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    remove(path);
+    return rename(temporaryPath.c_str(), path) == 0;
+}
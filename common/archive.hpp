@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <common/mappedfile.hpp>
+
+// Start of an archive file
+struct ArchiveHeader
+{
+    char     magic[4];          // "APAK"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t blockSize;         // uncompressed size of each compressed block
+    uint64_t entryOffset;       // of the table of entries, sorted by name
+    uint64_t nameOffset;        // of the null terminated entry names
+    uint64_t dataOffset;        // of the first entry's data
+    uint64_t reserved[3];
+};
+
+// Table of contents entry for one packed file. Compressed entries start with
+// a table of the end offset of each block (relative to the end of the table)
+// followed by the blocks, each stored as is if it didn't compress.
+struct ArchiveEntry
+{
+    uint64_t offset;            // of the data from the start of the archive, 64-byte aligned
+    uint64_t size;              // of the file
+    uint64_t storedSize;        // of the data in the archive
+    int64_t  time;              // modification time of the packed file
+    uint32_t nameOffset;        // from the start of the name block
+    uint32_t nameLength;
+    uint32_t blockCount;        // 0 if the file is stored uncompressed
+    uint32_t reserved;
+};
+
+// Reader of whole files from the mounted archive, so header-only loaders can
+// use it without linking archive.cpp
+typedef bool (*ArchiveReader)(const char *name, std::string &contents);
+
+inline ArchiveReader &archiveReader()
+{
+    static ArchiveReader reader = NULL;
+    return reader;
+}
+
+// Read a file from the mounted archive, or from disk if it isn't in there
+inline bool readAsset(const char *path, std::string &contents)
+{
+    if (archiveReader() != NULL && archiveReader()(path, contents))
+        return true;
+
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream.is_open())
+        return false;
+    std::stringstream sstr;
+    sstr << stream.rdbuf();
+    contents = sstr.str();
+    return true;
+}
+
+// Single file of assets with a memory mapped table of contents. Files are
+// found by the path they were packed with (e.g. "../assets/teapot.obj"), so
+// a mounted archive stands in for the files it holds wherever MappedFile,
+// readAsset or the mesh cache open them.
+class AssetArchive
+{
+public:
+    AssetArchive() : header(NULL), entries(NULL), names(NULL) {}
+    ~AssetArchive() { close(); }
+
+    // Map an archive and check its table of contents
+    bool open(const char *path);
+    void close();
+    bool isOpen() const { return header != NULL; }
+
+    // Entries, in name order
+    unsigned int entryCount() const { return header ? header->entryCount : 0; }
+    const ArchiveEntry &entry(unsigned int index) const { return entries[index]; }
+    const char *name(const ArchiveEntry &entry) const { return names + entry.nameOffset; }
+
+    // Find a file (NULL if the archive hasn't got it)
+    const ArchiveEntry *find(const char *path) const;
+
+    // Open a file in the archive. Stored files are views of the archive's
+    // mapping and compressed ones are decompressed, a block per task.
+    bool open(const char *path, MappedFile &file) const;
+
+    // Decompress or copy a file's contents to size bytes at out
+    bool read(const ArchiveEntry &entry, void *out) const;
+
+    // Archive used in place of the files it holds (NULL to unmount). Closing
+    // it unmounts it.
+    static void mount(AssetArchive *archive);
+    static AssetArchive *mounted();
+
+    // Pack files into an archive, compressing each in blocks of blockSize
+    // bytes if compress is set and it makes the file smaller
+    static bool pack(const char *path, const std::vector<std::string> &files, bool compress,
+                     unsigned int blockSize = 256 * 1024);
+
+    // Name a path is packed and found under: forward slashes, no leading "./"
+    static std::string normalise(const char *path);
+
+private:
+    MappedFile mapping;
+    const ArchiveHeader *header;
+    const ArchiveEntry *entries;
+    const char *names;
+
+    AssetArchive(const AssetArchive &) = delete;
+    AssetArchive &operator=(const AssetArchive &) = delete;
+};
@@ -0,0 +1,164 @@
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include <GL/glew.h>
+
+#include <common/assetloader.hpp>
+#include <common/threadpool.hpp>
+
+AssetLoader::AssetLoader(size_t uploadBudget)
+{
+    this->uploadBudget = uploadBudget;
+    queue          = std::make_shared<Queue>();
+    loading        = 0;
+    placeholder    = NULL;
+    lastUpdateTime = 0.0;
+    maxUpdateTime  = 0.0;
+    
+    queue->working   = 0;
+    queue->cancelled = false;
+}
+
+AssetLoader::~AssetLoader()
+{
+    // Take the uploads once every task has queued its own, and destroy them
+    // (and any assets only they hold) here on the GL thread
+    std::deque<std::function<size_t()> > dropped;
+    {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        queue->cancelled = true;
+        queue->finished.wait(lock, [this]() { return queue->working == 0; });
+        dropped.swap(queue->uploads);
+    }
+}
+
+std::shared_ptr<Model> AssetLoader::loadModel(const char *path, const ModelOptions &options)
+{
+    std::shared_ptr<Model> model(new Model());
+    model->placeholder = placeholder;
+    loading++;
+
+    // Parse on a worker, then queue the upload, moving the worker's
+    // reference into it so the last one is always released on the GL thread
+    std::shared_ptr<Queue> queue = this->queue;
+    std::string file = path;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->working++;
+    }
+    ThreadPool::shared().submit([queue, model, file, options]() mutable
+    {
+        bool cancelled;
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            cancelled = queue->cancelled;
+        }
+        if (!cancelled)
+            model->load(file.c_str(), options);
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->uploads.push_back(std::bind(uploadModel, std::move(model)));
+        queue->working--;
+        queue->finished.notify_all();
+    });
+
+    return model;
+}
+
+std::shared_ptr<GLTexture> AssetLoader::loadTexture(const char *path, const glm::vec4 &placeholder)
+{
+    // Create the texture with a single pixel of the placeholder colour
+    std::shared_ptr<GLTexture> texture = std::make_shared<GLTexture>(GLTexture::create());
+    glBindTexture(GL_TEXTURE_2D, texture->id());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, &placeholder[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    loading++;
+
+    // Decode on a worker, then queue the upload into the same texture,
+    // which takes over the worker's reference as for models
+    std::shared_ptr<Queue> queue = this->queue;
+    std::string file = path;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->working++;
+    }
+    ThreadPool::shared().submit([queue, texture, file]() mutable
+    {
+        bool cancelled;
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            cancelled = queue->cancelled;
+        }
+        std::shared_ptr<TextureData> data;
+        if (!cancelled)
+        {
+            data = std::make_shared<TextureData>();
+            if (!TextureCache::read(file.c_str(), TextureSettings(), *data))
+            {
+                printf("Texture %s failed to load.\n", file.c_str());
+                data.reset();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->uploads.push_back(std::bind(uploadTexture, std::move(texture), data));
+        queue->working--;
+        queue->finished.notify_all();
+    });
+
+    return texture;
+}
+
+unsigned int AssetLoader::update()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Upload until the budget is spent, taking the queue lock only to pop
+    size_t uploaded = 0;
+    unsigned int count = 0;
+    while (count == 0 || uploaded < uploadBudget)
+    {
+        std::function<size_t()> upload;
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (queue->uploads.empty())
+                break;
+            upload = std::move(queue->uploads.front());
+            queue->uploads.pop_front();
+        }
+        uploaded += upload();
+        count++;
+    }
+    loading -= count;
+
+    lastUpdateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (lastUpdateTime > maxUpdateTime)
+        maxUpdateTime = lastUpdateTime;
+    return count;
+}
+
+// Upload a loaded model unless it was dropped while it loaded
+size_t AssetLoader::uploadModel(std::shared_ptr<Model> &model)
+{
+    if (model.use_count() == 1)
+        return 0;
+    
+    size_t size = model->uploadSize();
+    model->upload();
+    return size;
+}
+
+// Upload a decoded image into its texture unless it failed or the
+// texture was dropped while it decoded
+size_t AssetLoader::uploadTexture(std::shared_ptr<GLTexture> &texture, const std::shared_ptr<TextureData> &data)
+{
+    if (!data || texture.use_count() == 1)
+        return 0;
+
+    TextureCache::upload(*texture, *data, TextureSettings());
+    return texture->size();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <glm/glm.hpp>
+
+#include <common/globject.hpp>
+#include <common/model.hpp>
+#include <common/texturecache.hpp>
+
+// Loads models and textures on the shared thread pool and uploads them on
+// the GL thread a few at a time, so that loading doesn't hold up frames.
+// Assets are usable straight away and show placeholders until uploaded.
+class AssetLoader
+{
+public:
+    // Constructor (uploadBudget is the number of bytes update() uploads
+    // before it stops, though it always uploads at least one asset)
+    AssetLoader(size_t uploadBudget = 16 << 20);
+
+    // Destructor skips loads that haven't started, waits for the rest and
+    // drops what they loaded without uploading it (call on the GL thread)
+    ~AssetLoader();
+
+    // Start loading a model
+    std::shared_ptr<Model> loadModel(const char *path, const ModelOptions &options = ModelOptions());
+
+    // Start loading a texture, returning a texture that holds one pixel of
+    // the placeholder colour until the image is uploaded
+    std::shared_ptr<GLTexture> loadTexture(const char *path,
+                                           const glm::vec4 &placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+
+    // Model drawn in place of models that haven't been uploaded (NULL draws
+    // nothing). Applies to models loaded after it is set.
+    void setPlaceholder(Model *model) { placeholder = model; }
+
+    // Upload loaded assets within the budget, returning how many were
+    // uploaded (call once a frame on the GL thread)
+    unsigned int update();
+
+    // Number of assets still loading or waiting to be uploaded
+    unsigned int pending() const { return loading; }
+
+    // Time spent in the last update() and the longest so far, in milliseconds
+    // (time to issue the GL calls, not for the GPU to finish them)
+    double lastUpdateTime;
+    double maxUpdateTime;
+
+private:
+    // Uploads of loaded assets, each returning the number of bytes it sent.
+    // The uploads own the assets, so an asset dropped while it loads is
+    // destroyed with its upload on the GL thread rather than on a worker.
+    struct Queue
+    {
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::deque<std::function<size_t()> > uploads;
+        unsigned int working;       // tasks submitted that haven't queued their upload
+        bool cancelled;             // set by the destructor to skip loads not yet started
+    };
+    std::shared_ptr<Queue> queue;
+
+    // Upload a loaded model, or an image read for a texture into it, unless
+    // the load failed or the asset was dropped while it loaded
+    static size_t uploadModel(std::shared_ptr<Model> &model);
+    static size_t uploadTexture(std::shared_ptr<GLTexture> &texture, const std::shared_ptr<TextureData> &data);
+
+    size_t uploadBudget;
+    unsigned int loading;
+    Model *placeholder;
+
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader &operator=(const AssetLoader &) = delete;
+};
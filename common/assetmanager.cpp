@@ -0,0 +1,393 @@
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+
+#include <GL/glew.h>
+
+#include <common/archive.hpp>
+#include <common/assetmanager.hpp>
+#include <common/assetloader.hpp>
+#include <common/texturecache.hpp>
+#include <common/threadpool.hpp>
+
+namespace
+{
+    double milliseconds(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    // Compile a shader, printing its log if it doesn't compile (0 if it doesn't)
+    unsigned int compileShader(GLenum type, const std::string &path)
+    {
+        std::string code;
+        if (!readAsset(path.c_str(), code))
+        {
+            printf("Couldn't read %s\n", path.c_str());
+            return 0;
+        }
+        unsigned int shader = glCreateShader(type);
+        const char *source = code.c_str();
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+
+        GLint compiled = GL_FALSE, logLength = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (compiled == GL_TRUE)
+            return shader;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::vector<char> log(logLength + 1);
+        glGetShaderInfoLog(shader, logLength, NULL, log.data());
+        printf("%s doesn't compile:\n%s\n", path.c_str(), log.data());
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    // Relink a program from its shader files. They are linked into a scratch
+    // program first, so shaders that don't compile or link never replace a
+    // working program.
+    bool relinkProgram(unsigned int program, const std::string &vertexPath, const std::string &fragmentPath)
+    {
+        unsigned int vertexShader   = compileShader(GL_VERTEX_SHADER, vertexPath);
+        unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentPath);
+        GLint linked = GL_FALSE;
+        if (vertexShader != 0 && fragmentShader != 0)
+        {
+            unsigned int scratch = glCreateProgram();
+            glAttachShader(scratch, vertexShader);
+            glAttachShader(scratch, fragmentShader);
+            glLinkProgram(scratch);
+            glGetProgramiv(scratch, GL_LINK_STATUS, &linked);
+            if (linked != GL_TRUE)
+            {
+                GLint logLength = 0;
+                glGetProgramiv(scratch, GL_INFO_LOG_LENGTH, &logLength);
+                std::vector<char> log(logLength + 1);
+                glGetProgramInfoLog(scratch, logLength, NULL, log.data());
+                printf("%s and %s don't link:\n%s\n", vertexPath.c_str(), fragmentPath.c_str(), log.data());
+            }
+            glDeleteProgram(scratch);
+        }
+
+        // Then link the program itself, which keeps its name
+        if (linked == GL_TRUE)
+        {
+            glAttachShader(program, vertexShader);
+            glAttachShader(program, fragmentShader);
+            glLinkProgram(program);
+            glDetachShader(program, vertexShader);
+            glDetachShader(program, fragmentShader);
+        }
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return linked == GL_TRUE;
+    }
+}
+
+AssetManager::AssetManager(AssetLoader *loader)
+{
+    this->loader = loader;
+    loads   = 0;
+    hits    = 0;
+    reloads = std::make_shared<ReloadQueue>();
+}
+
+std::shared_ptr<Model> AssetManager::model(const char *path, const ModelOptions &options)
+{
+    std::string file = canonicalPath(path);
+    std::string key  = file + "|" + optionsKey(options);
+    std::shared_ptr<Model> model = models[key].lock();
+    if (model)
+    {
+        hits++;
+        return model;
+    }
+
+    // Load it (models dropped before they are uploaded are never uploaded)
+    model = loader != NULL ? loader->loadModel(path, options) : std::make_shared<Model>(path, options);
+    models[key] = model;
+    modelOptions[key] = options;
+    if (watcher)
+        watcher->watch(file);
+    loads++;
+    return model;
+}
+
+TextureHandle AssetManager::texture(const char *path)
+{
+    std::string key = canonicalPath(path);
+    std::shared_ptr<GLTexture> texture = textures[key].lock();
+    if (texture)
+        hits++;
+    else
+    {
+        texture = loader != NULL ? loader->loadTexture(path) : loadTexture(path);
+        textures[key] = texture;
+        if (watcher)
+            watcher->watch(key);
+        loads++;
+    }
+    return TextureHandle(texture, &texture->id());
+}
+
+AssetStats AssetManager::stats() const
+{
+    AssetStats stats;
+    stats.models   = 0;
+    stats.textures = 0;
+    stats.loads    = loads;
+    stats.hits     = hits;
+    stats.memory   = 0;
+    for (std::map<std::string, std::weak_ptr<Model> >::const_iterator it = models.begin(); it != models.end(); ++it)
+    {
+        std::shared_ptr<Model> model = it->second.lock();
+        if (!model)
+            continue;
+        stats.models++;
+        if (model->isReady())
+            stats.memory += model->uploadSize();
+    }
+    for (std::map<std::string, std::weak_ptr<GLTexture> >::const_iterator it = textures.begin(); it != textures.end(); ++it)
+    {
+        std::shared_ptr<GLTexture> texture = it->second.lock();
+        if (!texture)
+            continue;
+        stats.textures++;
+        stats.memory += texture->size();
+    }
+    return stats;
+}
+
+void AssetManager::report() const
+{
+    AssetStats total = stats();
+    printf("%u models, %u textures, %.2f MB (%u loads, %u shared)\n", total.models, total.textures,
+           total.memory / 1048576.0, total.loads, total.hits);
+    for (std::map<std::string, std::weak_ptr<Model> >::const_iterator it = models.begin(); it != models.end(); ++it)
+    {
+        std::shared_ptr<Model> model = it->second.lock();
+        if (model)
+            printf("    %8.1f KB  %ld handles  %s\n", model->isReady() ? model->uploadSize() / 1024.0 : 0.0,
+                   model.use_count() - 1, it->first.c_str());
+    }
+    for (std::map<std::string, std::weak_ptr<GLTexture> >::const_iterator it = textures.begin(); it != textures.end(); ++it)
+    {
+        std::shared_ptr<GLTexture> texture = it->second.lock();
+        if (texture)
+            printf("    %8.1f KB  %ld handles  %s\n", texture->size() / 1024.0, texture.use_count() - 1, it->first.c_str());
+    }
+}
+
+std::string AssetManager::canonicalPath(const char *path)
+{
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path, _MAX_PATH) != NULL)
+        return resolved;
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) != NULL)
+        return resolved;
+#endif
+    return path;
+}
+
+std::string AssetManager::optionsKey(const ModelOptions &options)
+{
+    std::ostringstream key;
+    key << options.vertexLayout.code() << "," << options.positionStream << "," << options.orientedBox << ","
+        << options.meshlets << "," << options.releaseMesh << "," << options.keepPositions << ","
+        << options.streamWindow << "," << options.lodPixelError << "," << options.lodScreenHeight << ","
+        << options.pool;
+    for (size_t i = 0; i < options.lodLevels.size(); i++)
+        key << "," << options.lodLevels[i];
+    return key.str();
+}
+
+std::shared_ptr<GLTexture> AssetManager::loadTexture(const char *path)
+{
+    std::shared_ptr<GLTexture> texture = std::make_shared<GLTexture>(GLTexture::create());
+    TextureData data;
+    if (!TextureCache::read(path, TextureSettings(), data))
+    {
+        printf("Texture %s failed to load.\n", path);
+        return texture;
+    }
+    TextureCache::upload(*texture, data, TextureSettings());
+    return texture;
+}
+
+void AssetManager::enableHotReload()
+{
+    if (watcher)
+        return;
+    watcher.reset(new FileWatcher());
+    for (std::map<std::string, std::weak_ptr<Model> >::const_iterator it = models.begin(); it != models.end(); ++it)
+        watcher->watch(it->first.substr(0, it->first.find('|')));
+    for (std::map<std::string, std::weak_ptr<GLTexture> >::const_iterator it = textures.begin(); it != textures.end(); ++it)
+        watcher->watch(it->first);
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        watcher->watch(programs[i].vertexPath);
+        watcher->watch(programs[i].fragmentPath);
+    }
+}
+
+void AssetManager::watchShaders(unsigned int program, const char *vertexPath, const char *fragmentPath)
+{
+    WatchedProgram watched;
+    watched.program      = program;
+    watched.vertexPath   = canonicalPath(vertexPath);
+    watched.fragmentPath = canonicalPath(fragmentPath);
+    programs.push_back(watched);
+    if (watcher)
+    {
+        watcher->watch(watched.vertexPath);
+        watcher->watch(watched.fragmentPath);
+    }
+}
+
+unsigned int AssetManager::reload()
+{
+    if (!watcher)
+        return 0;
+
+    // Note when each file was seen to change
+    std::vector<std::string> changed = watcher->changes();
+    TimePoint now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < changed.size(); i++)
+        changes[changed[i]] = now;
+
+    // Start reloading what uses the changed files, keeping the files of
+    // assets that haven't finished loading for a later frame
+    unsigned int applied = 0;
+    for (std::map<std::string, TimePoint>::iterator change = changes.begin(); change != changes.end(); )
+    {
+        const std::string &path = change->first;
+        bool waiting = false;
+
+        // Programs are relinked straight away
+        for (size_t i = 0; i < programs.size(); i++)
+        {
+            if (programs[i].vertexPath != path && programs[i].fragmentPath != path)
+                continue;
+            if (relinkProgram(programs[i].program, programs[i].vertexPath, programs[i].fragmentPath))
+            {
+                printf("Relinked program %u after %s changed in %.1f ms\n", programs[i].program, path.c_str(),
+                       milliseconds(change->second, std::chrono::steady_clock::now()));
+                applied++;
+            }
+            else
+                printf("Kept the old program %u\n", programs[i].program);
+        }
+
+        // Textures whose images have been uploaded
+        std::map<std::string, std::weak_ptr<GLTexture> >::const_iterator texture = textures.find(path);
+        std::shared_ptr<GLTexture> liveTexture;
+        if (texture != textures.end())
+            liveTexture = texture->second.lock();
+        if (liveTexture && liveTexture->size() == 0 && loader != NULL && loader->pending() > 0)
+            waiting = true;
+        else if (liveTexture)
+            reloadTexture(path, change->second);
+
+        // Models loaded from the file with any options
+        std::string prefix = path + "|";
+        for (std::map<std::string, std::weak_ptr<Model> >::const_iterator it = models.lower_bound(prefix);
+             it != models.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+            std::shared_ptr<Model> model = it->second.lock();
+            if (model && !model->isReady())
+                waiting = true;
+            else if (model)
+                reloadModel(it->first, path, change->second);
+        }
+
+        if (waiting)
+            ++change;
+        else
+            changes.erase(change++);
+    }
+
+    // Apply the reloads that have finished loading
+    std::deque<std::function<bool()> > ready;
+    {
+        std::lock_guard<std::mutex> lock(reloads->mutex);
+        ready.swap(reloads->ready);
+    }
+    for (size_t i = 0; i < ready.size(); i++)
+        applied += ready[i]() ? 1 : 0;
+    return applied;
+}
+
+void AssetManager::reloadModel(const std::string &key, const std::string &path, TimePoint changed)
+{
+    // Load a fresh copy on a worker, then move its mesh into the live model
+    // if nothing has started a newer reload of it
+    unsigned int generation = ++generations[key];
+    std::weak_ptr<Model> target = models[key];
+    ModelOptions options = modelOptions[key];
+    std::shared_ptr<ReloadQueue> queue = reloads;
+    ThreadPool::shared().submit([this, queue, key, path, options, target, generation, changed]()
+    {
+        TimePoint start = std::chrono::steady_clock::now();
+        std::shared_ptr<Model> fresh(new Model());
+        fresh->load(path.c_str(), options);
+        double loadTime = milliseconds(start, std::chrono::steady_clock::now());
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->ready.push_back([this, key, path, target, generation, changed, fresh, loadTime]()
+        {
+            std::shared_ptr<Model> model = target.lock();
+            if (!model || generations[key] != generation)
+                return false;
+            if (fresh->vertexCount == 0 && !fresh->pendingVertexFile)
+            {
+                printf("Reloading %s failed, keeping the old mesh\n", path.c_str());
+                return false;
+            }
+
+            TimePoint start = std::chrono::steady_clock::now();
+            model->replaceMesh(*fresh);
+            TimePoint end = std::chrono::steady_clock::now();
+            printf("Reloaded %s in %.1f ms (%.1f ms to load, %.2f ms to upload %.1f KB)\n", path.c_str(),
+                   milliseconds(changed, end), loadTime, milliseconds(start, end), model->uploadSize() / 1024.0);
+            return true;
+        });
+    });
+}
+
+void AssetManager::reloadTexture(const std::string &path, TimePoint changed)
+{
+    // Decode on a worker, then re-specify the live texture
+    unsigned int generation = ++generations[path];
+    std::weak_ptr<GLTexture> target = textures[path];
+    std::shared_ptr<ReloadQueue> queue = reloads;
+    ThreadPool::shared().submit([this, queue, path, target, generation, changed]()
+    {
+        TimePoint start = std::chrono::steady_clock::now();
+        std::shared_ptr<TextureData> data = std::make_shared<TextureData>();
+        bool read = TextureCache::read(path.c_str(), TextureSettings(), *data);
+        double decodeTime = milliseconds(start, std::chrono::steady_clock::now());
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->ready.push_back([this, path, target, generation, changed, data, read, decodeTime]()
+        {
+            std::shared_ptr<GLTexture> texture = target.lock();
+            if (!texture || generations[path] != generation)
+                return false;
+            if (!read)
+            {
+                printf("Reloading %s failed, keeping the old image\n", path.c_str());
+                return false;
+            }
+
+            TimePoint start = std::chrono::steady_clock::now();
+            TextureCache::upload(*texture, *data, TextureSettings());
+            TimePoint end = std::chrono::steady_clock::now();
+            printf("Reloaded %s in %.1f ms (%.1f ms to decode, %.2f ms to upload)\n", path.c_str(),
+                   milliseconds(changed, end), decodeTime, milliseconds(start, end));
+            return true;
+        });
+    });
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <common/filewatcher.hpp>
+#include <common/globject.hpp>
+#include <common/model.hpp>
+
+class AssetLoader;
+
+// Counts kept by an AssetManager
+struct AssetStats
+{
+    unsigned int models;        // live models and textures
+    unsigned int textures;
+    unsigned int loads;         // requests that loaded an asset
+    unsigned int hits;          // requests that shared a live one
+    size_t       memory;        // bytes of GPU memory held by live assets
+};
+
+// Registry of models and textures keyed by canonical path (and import
+// options for models). Requests for an asset that is still alive share it,
+// and an asset is destroyed, freeing its GPU resources, when its last handle
+// goes. Use on the GL thread only.
+class AssetManager
+{
+public:
+    // Constructor (assets are loaded through the loader if one is given and
+    // synchronously otherwise)
+    AssetManager(AssetLoader *loader = NULL);
+
+    // Get a model, loading it if it isn't alive. Models are shared along with
+    // their material, so set the material once after loading.
+    std::shared_ptr<Model> model(const char *path, const ModelOptions &options = ModelOptions());
+
+    // Get a texture, loading it if it isn't alive
+    TextureHandle texture(const char *path);
+
+    // Current counts, with the memory of assets still loading left out
+    AssetStats stats() const;
+
+    // Print the live assets and their sizes
+    void report() const;
+
+    // Watch the files of the models and textures it holds, and of shaders
+    // given to watchShaders(), so that reload() picks up changes to them
+    void enableHotReload();
+
+    // Relink a program when either of its shader files changes. The program
+    // keeps its name, so ids held elsewhere stay valid, but its uniforms go
+    // back to their defaults as after any link.
+    void watchShaders(unsigned int program, const char *vertexPath, const char *fragmentPath);
+
+    // Start reloading assets whose files have changed and apply the reloads
+    // that are ready, returning how many were applied (call once a frame on
+    // the GL thread). Models are parsed on the shared thread pool and
+    // re-uploaded into their own buffers, textures are re-specified in place
+    // and programs are only replaced if the new shaders link. Assets whose
+    // files haven't changed are left alone.
+    unsigned int reload();
+
+private:
+    AssetLoader *loader;
+    unsigned int loads, hits;
+    std::map<std::string, std::weak_ptr<Model> > models;
+    std::map<std::string, std::weak_ptr<GLTexture> > textures;
+
+    // Hot reload state: the options each model was loaded with, programs and
+    // their shader files, files changed since the reloads were started (kept
+    // while an asset using them is still loading), the reloads started for
+    // each asset so only the latest is applied, and finished loads waiting to
+    // be applied on the GL thread
+    struct WatchedProgram
+    {
+        unsigned int program;
+        std::string vertexPath;
+        std::string fragmentPath;
+    };
+    struct ReloadQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<bool()> > ready;
+    };
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    std::unique_ptr<FileWatcher> watcher;
+    std::map<std::string, ModelOptions> modelOptions;
+    std::vector<WatchedProgram> programs;
+    std::map<std::string, TimePoint> changes;
+    std::map<std::string, unsigned int> generations;
+    std::shared_ptr<ReloadQueue> reloads;
+
+    // Start reloading a model or a texture on the thread pool
+    void reloadModel(const std::string &key, const std::string &path, TimePoint changed);
+    void reloadTexture(const std::string &path, TimePoint changed);
+
+    // Absolute path with links and . and .. resolved (the path as given if
+    // the file doesn't exist)
+    static std::string canonicalPath(const char *path);
+
+    // Key of the options that change what a model holds (every field of
+    // ModelOptions, so keep it in step with them)
+    static std::string optionsKey(const ModelOptions &options);
+
+    // Load and upload a texture
+    static std::shared_ptr<GLTexture> loadTexture(const char *path);
+};
@@ -0,0 +1,356 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#include <common/blockcompression.hpp>
+#include <common/threadpool.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCK_SSE
+#endif
+
+namespace
+{
+    // Pixels of a block split into channels
+    struct BlockPixels
+    {
+        float r[16], g[16], b[16];
+    };
+
+    // Weight of the first endpoint for each BC1 index
+    const float endpointWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    // BC1 index of each step along the line from the second endpoint to the
+    // first
+    const uint32_t stepIndices[4] = { 1, 3, 2, 0 };
+
+    uint16_t pack565(const float colour[3])
+    {
+        int r = static_cast<int>(std::floor(std::min(std::max(colour[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f));
+        int g = static_cast<int>(std::floor(std::min(std::max(colour[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f));
+        int b = static_cast<int>(std::floor(std::min(std::max(colour[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f));
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    // Expand a 5:6:5 colour the way the hardware does
+    void unpack565(uint16_t packed, float colour[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        colour[0] = static_cast<float>((r << 3) | (r >> 2));
+        colour[1] = static_cast<float>((g << 2) | (g >> 4));
+        colour[2] = static_cast<float>((b << 3) | (b >> 2));
+    }
+
+    // Pick the BC1 index of each pixel by projecting it onto the line
+    // between the endpoints
+    uint32_t selectIndices(const BlockPixels &pixels, const float first[3], const float second[3])
+    {
+        float d[3] = { first[0] - second[0], first[1] - second[1], first[2] - second[2] };
+        float lengthSquared = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        if (lengthSquared == 0.0f)
+            return 0;
+        float scale = 3.0f / lengthSquared;
+        int steps[16];
+
+#ifdef BLOCK_SSE
+        __m128 dr = _mm_set1_ps(d[0] * scale), dg = _mm_set1_ps(d[1] * scale), db = _mm_set1_ps(d[2] * scale);
+        __m128 sr = _mm_set1_ps(second[0]), sg = _mm_set1_ps(second[1]), sb = _mm_set1_ps(second[2]);
+        __m128 zero = _mm_setzero_ps(), three = _mm_set1_ps(3.0f);
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pixels.r + i), sr), dr),
+                                             _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pixels.g + i), sg), dg)),
+                                  _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pixels.b + i), sb), db));
+            t = _mm_min_ps(_mm_max_ps(t, zero), three);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(steps + i), _mm_cvtps_epi32(t));
+        }
+#else
+        for (int i = 0; i < 16; i++)
+        {
+            float t = ((pixels.r[i] - second[0]) * d[0] + (pixels.g[i] - second[1]) * d[1] +
+                       (pixels.b[i] - second[2]) * d[2]) * scale;
+            steps[i] = static_cast<int>(std::floor(std::min(std::max(t, 0.0f), 3.0f) + 0.5f));
+        }
+#endif
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; i++)
+            indices |= stepIndices[steps[i]] << (2 * i);
+        return indices;
+    }
+
+    // Squared error of a BC1 block
+    float blockError(const BlockPixels &pixels, uint16_t first, uint16_t second, uint32_t indices)
+    {
+        float palette[4][3];
+        unpack565(first, palette[0]);
+        unpack565(second, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        float error = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            const float *colour = palette[(indices >> (2 * i)) & 3];
+            float dr = pixels.r[i] - colour[0], dg = pixels.g[i] - colour[1], db = pixels.b[i] - colour[2];
+            error += dr * dr + dg * dg + db * db;
+        }
+        return error;
+    }
+
+    // Quantise the endpoints and pick the indices, keeping the first
+    // endpoint larger so the block uses four colours
+    void fitBlock(const BlockPixels &pixels, const float first[3], const float second[3],
+                  uint16_t &packedFirst, uint16_t &packedSecond, uint32_t &indices)
+    {
+        packedFirst  = pack565(first);
+        packedSecond = pack565(second);
+        if (packedFirst < packedSecond)
+            std::swap(packedFirst, packedSecond);
+        if (packedFirst == packedSecond)
+        {
+            indices = 0;
+            return;
+        }
+        float a[3], b[3];
+        unpack565(packedFirst, a);
+        unpack565(packedSecond, b);
+        indices = selectIndices(pixels, a, b);
+    }
+
+    void compressBC1(const unsigned char *rgba, unsigned char *out)
+    {
+        BlockPixels pixels;
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+        {
+            pixels.r[i] = rgba[4 * i];
+            pixels.g[i] = rgba[4 * i + 1];
+            pixels.b[i] = rgba[4 * i + 2];
+            mean[0] += pixels.r[i];
+            mean[1] += pixels.g[i];
+            mean[2] += pixels.b[i];
+        }
+        for (int c = 0; c < 3; c++)
+            mean[c] /= 16.0f;
+
+        // Principal axis of the colours by power iteration on their covariance
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+        {
+            float r = pixels.r[i] - mean[0], g = pixels.g[i] - mean[1], b = pixels.b[i] - mean[2];
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float largest = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+            if (largest == 0.0f)
+                break;
+            axis[0] = x / largest;
+            axis[1] = y / largest;
+            axis[2] = z / largest;
+        }
+
+        // Endpoints at the extremes along the axis, inset by a sixteenth of
+        // the range as the extremes are rarely hit exactly
+        float low = 0.0f, high = 0.0f;
+        float lengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        for (int i = 0; i < 16 && lengthSquared > 0.0f; i++)
+        {
+            float t = ((pixels.r[i] - mean[0]) * axis[0] + (pixels.g[i] - mean[1]) * axis[1] +
+                       (pixels.b[i] - mean[2]) * axis[2]) / lengthSquared;
+            low  = std::min(low, t);
+            high = std::max(high, t);
+        }
+        float inset = (high - low) / 16.0f;
+        float first[3], second[3];
+        for (int c = 0; c < 3; c++)
+        {
+            first[c]  = mean[c] + axis[c] * (high - inset);
+            second[c] = mean[c] + axis[c] * (low + inset);
+        }
+        uint16_t packedFirst, packedSecond;
+        uint32_t indices;
+        fitBlock(pixels, first, second, packedFirst, packedSecond, indices);
+
+        // Refit the endpoints to the chosen indices by least squares and keep
+        // the result if it is better
+        if (packedFirst != packedSecond)
+        {
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < 16; i++)
+            {
+                float a = endpointWeights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+                float colour[3] = { pixels.r[i], pixels.g[i], pixels.b[i] };
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int c = 0; c < 3; c++)
+                {
+                    ax[c] += a * colour[c];
+                    bx[c] += b * colour[c];
+                }
+            }
+            float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) > 1e-6f)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    first[c]  = (bb * ax[c] - ab * bx[c]) / determinant;
+                    second[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+                }
+                uint16_t refitFirst, refitSecond;
+                uint32_t refitIndices;
+                fitBlock(pixels, first, second, refitFirst, refitSecond, refitIndices);
+                if (blockError(pixels, refitFirst, refitSecond, refitIndices) <
+                    blockError(pixels, packedFirst, packedSecond, indices))
+                {
+                    packedFirst  = refitFirst;
+                    packedSecond = refitSecond;
+                    indices      = refitIndices;
+                }
+            }
+        }
+
+        out[0] = static_cast<unsigned char>(packedFirst & 0xFF);
+        out[1] = static_cast<unsigned char>(packedFirst >> 8);
+        out[2] = static_cast<unsigned char>(packedSecond & 0xFF);
+        out[3] = static_cast<unsigned char>(packedSecond >> 8);
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+
+    // One channel of 16 pixels, in the eight value mode between the block's
+    // minimum and maximum (BC4, and the alpha of BC3)
+    void compressChannel(const unsigned char *rgba, int channel, unsigned char *out)
+    {
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low  = std::min(low, int(rgba[4 * i + channel]));
+            high = std::max(high, int(rgba[4 * i + channel]));
+        }
+        out[0] = static_cast<unsigned char>(high);
+        out[1] = static_cast<unsigned char>(low);
+
+        // Steps from the minimum, where 0 is index 1, 7 is index 0 and the
+        // steps between count down from index 7
+        uint64_t indices = 0;
+        int range = high - low;
+        for (int i = 0; range > 0 && i < 16; i++)
+        {
+            int step = ((rgba[4 * i + channel] - low) * 14 + range) / (2 * range);
+            uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (3 * i);
+        }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+size_t BlockCompression::blockSize(BlockFormat format)
+{
+    return format == BlockBC1 ? 8 : 16;
+}
+
+size_t BlockCompression::imageSize(BlockFormat format, int width, int height)
+{
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+GLenum BlockCompression::internalFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockBC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockBC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+GLenum BlockCompression::baseFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockBC1:
+        return GL_RGB;
+    case BlockBC3:
+        return GL_RGBA;
+    default:
+        return GL_RG;
+    }
+}
+
+const char *BlockCompression::name(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockBC1:
+        return "BC1";
+    case BlockBC3:
+        return "BC3";
+    default:
+        return "BC5";
+    }
+}
+
+void BlockCompression::compressBlock(const unsigned char *rgba, BlockFormat format, unsigned char *out)
+{
+    switch (format)
+    {
+    case BlockBC1:
+        compressBC1(rgba, out);
+        break;
+    case BlockBC3:
+        compressChannel(rgba, 3, out);
+        compressBC1(rgba, out + 8);
+        break;
+    default:
+        compressChannel(rgba, 0, out);
+        compressChannel(rgba, 1, out + 8);
+        break;
+    }
+}
+
+void BlockCompression::compress(const unsigned char *rgba, int width, int height, BlockFormat format,
+                                std::vector<unsigned char> &out)
+{
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    size_t size = blockSize(format);
+    out.resize(imageSize(format, width, height));
+    ThreadPool::shared().parallelFor(static_cast<unsigned int>(blocksHigh), [&](unsigned int row)
+    {
+        unsigned char block[64];
+        for (int column = 0; column < blocksWide; column++)
+        {
+            // Gather the block, repeating the last row and column of images
+            // that don't fill it
+            for (int y = 0; y < 4; y++)
+            {
+                int sourceY = std::min(int(row) * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++)
+                {
+                    int sourceX = std::min(column * 4 + x, width - 1);
+                    memcpy(block + 4 * (4 * y + x), rgba + 4 * (size_t(sourceY) * width + sourceX), 4);
+                }
+            }
+            compressBlock(block, format, &out[(size_t(row) * blocksWide + column) * size]);
+        }
+    });
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Block compressed texture formats, each storing 4x4 pixel blocks
+enum BlockFormat
+{
+    BlockBC1,       // RGB, 8 bytes a block
+    BlockBC3,       // RGBA, 16 bytes a block
+    BlockBC5,       // two channels, 16 bytes a block (normal maps)
+    BlockFormatCount
+};
+
+// Encoding of RGBA8 images into block compressed formats on the CPU
+class BlockCompression
+{
+public:
+    // Bytes of a 4x4 block and of a whole image
+    static size_t blockSize(BlockFormat format);
+    static size_t imageSize(BlockFormat format, int width, int height);
+
+    // OpenGL internal and base formats
+    static GLenum internalFormat(BlockFormat format);
+    static GLenum baseFormat(BlockFormat format);
+
+    // Name for printing
+    static const char *name(BlockFormat format);
+
+    // Compress an RGBA8 image, whose size needn't be a multiple of 4, with
+    // the rows of blocks shared out over the shared thread pool. BC5 keeps
+    // the red and green channels.
+    static void compress(const unsigned char *rgba, int width, int height, BlockFormat format,
+                         std::vector<unsigned char> &out);
+
+    // Compress one block of 16 RGBA8 pixels, row by row
+    static void compressBlock(const unsigned char *rgba, BlockFormat format, unsigned char *out);
+};
@@ -0,0 +1,271 @@
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+
+#include <common/bounds.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BOUNDS_SSE
+#endif
+
+namespace
+{
+    // Directions the extreme points are looked for along when seeding the
+    // bounding sphere
+    const glm::vec3 directions[7] =
+    {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, -1.0f),
+        glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, -1.0f)
+    };
+
+    // Eigenvectors of a symmetric 3x3 matrix by Jacobi rotations, as the
+    // columns of vectors (a is left nearly diagonal)
+    void eigenvectors(double a[3][3], double vectors[3][3])
+    {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                vectors[i][j] = i == j ? 1.0 : 0.0;
+
+        for (int sweep = 0; sweep < 32; sweep++)
+        {
+            // Zero the largest element off the diagonal
+            int p = 0, q = 1;
+            if (std::fabs(a[0][2]) > std::fabs(a[p][q]))
+                p = 0, q = 2;
+            if (std::fabs(a[1][2]) > std::fabs(a[p][q]))
+                p = 1, q = 2;
+            if (std::fabs(a[p][q]) <= 1e-12 * (std::fabs(a[0][0]) + std::fabs(a[1][1]) + std::fabs(a[2][2])))
+                break;
+
+            double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+            double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+            double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+            for (int k = 0; k < 3; k++)
+            {
+                double kp = a[k][p], kq = a[k][q];
+                a[k][p] = c * kp - s * kq;
+                a[k][q] = s * kp + c * kq;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                double pk = a[p][k], qk = a[q][k];
+                a[p][k] = c * pk - s * qk;
+                a[q][k] = s * pk + c * qk;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                double kp = vectors[k][p], kq = vectors[k][q];
+                vectors[k][p] = c * kp - s * kq;
+                vectors[k][q] = s * kp + c * kq;
+            }
+        }
+    }
+}
+
+void BoundingVolumes::box(const glm::vec3 *positions, size_t count, glm::vec3 &min, glm::vec3 &max)
+{
+    if (count == 0)
+    {
+        min = max = glm::vec3(0.0f);
+        return;
+    }
+    min = max = positions[0];
+    size_t i = 0;
+
+#ifdef BOUNDS_SSE
+    // Four positions fill three registers as xyzx yzxy zxyz, so keep the
+    // minimum and maximum of each register and sort out the lanes at the end
+    if (count >= 4)
+    {
+        const float *data = &positions[0].x;
+        __m128 min0 = _mm_loadu_ps(data), min1 = _mm_loadu_ps(data + 4), min2 = _mm_loadu_ps(data + 8);
+        __m128 max0 = min0, max1 = min1, max2 = min2;
+        for (i = 4; i + 4 <= count; i += 4)
+        {
+            const float *p = data + 3 * i;
+            __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+            min0 = _mm_min_ps(min0, a);
+            min1 = _mm_min_ps(min1, b);
+            min2 = _mm_min_ps(min2, c);
+            max0 = _mm_max_ps(max0, a);
+            max1 = _mm_max_ps(max1, b);
+            max2 = _mm_max_ps(max2, c);
+        }
+
+        // Float j of the twelve holds component j % 3
+        float lows[12], highs[12];
+        _mm_storeu_ps(lows, min0);
+        _mm_storeu_ps(lows + 4, min1);
+        _mm_storeu_ps(lows + 8, min2);
+        _mm_storeu_ps(highs, max0);
+        _mm_storeu_ps(highs + 4, max1);
+        _mm_storeu_ps(highs + 8, max2);
+        for (int j = 0; j < 12; j++)
+        {
+            min[j % 3] = std::min(min[j % 3], lows[j]);
+            max[j % 3] = std::max(max[j % 3], highs[j]);
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        min = glm::min(min, positions[i]);
+        max = glm::max(max, positions[i]);
+    }
+}
+
+BoundingSphere BoundingVolumes::sphere(const glm::vec3 *positions, size_t count)
+{
+    BoundingSphere sphere = { glm::vec3(0.0f), 0.0f };
+    if (count == 0)
+        return sphere;
+
+    // Find the positions farthest along and against each direction
+    size_t lowest[7] = {}, highest[7] = {};
+    float low[7], high[7];
+    for (int d = 0; d < 7; d++)
+        low[d] = high[d] = glm::dot(positions[0], directions[d]);
+    for (size_t i = 1; i < count; i++)
+    {
+        for (int d = 0; d < 7; d++)
+        {
+            float t = glm::dot(positions[i], directions[d]);
+            if (t < low[d])
+            {
+                low[d]    = t;
+                lowest[d] = i;
+            }
+            if (t > high[d])
+            {
+                high[d]    = t;
+                highest[d] = i;
+            }
+        }
+    }
+
+    // Start from the pair farthest apart, then take in the rest
+    int widest = 0;
+    float widestSquared = -1.0f;
+    for (int d = 0; d < 7; d++)
+    {
+        glm::vec3 span = positions[highest[d]] - positions[lowest[d]];
+        if (glm::dot(span, span) > widestSquared)
+        {
+            widestSquared = glm::dot(span, span);
+            widest = d;
+        }
+    }
+    sphere.centre = 0.5f * (positions[lowest[widest]] + positions[highest[widest]]);
+    sphere.radius = 0.5f * std::sqrt(widestSquared);
+    grow(sphere, positions, count);
+    return sphere;
+}
+
+void BoundingVolumes::grow(BoundingSphere &sphere, const glm::vec3 *positions, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        // Move the centre towards a position outside, just far enough that
+        // the far side of the sphere stays where it was
+        glm::vec3 offset = positions[i] - sphere.centre;
+        float distanceSquared = glm::dot(offset, offset);
+        if (distanceSquared <= sphere.radius * sphere.radius)
+            continue;
+        float distance = std::sqrt(distanceSquared);
+        float radius   = 0.5f * (sphere.radius + distance);
+        sphere.centre += offset * ((radius - sphere.radius) / distance);
+        sphere.radius  = radius;
+    }
+}
+
+OrientedBox BoundingVolumes::orientedBox(const glm::vec3 *positions, size_t count)
+{
+    glm::vec3 min, max;
+    box(positions, count, min, max);
+    OrientedBox aligned = { 0.5f * (min + max), glm::mat3(1.0f), 0.5f * (max - min) };
+    if (count < 3)
+        return aligned;
+
+    // Covariance of the positions about their mean
+    glm::dvec3 mean(0.0);
+    for (size_t i = 0; i < count; i++)
+        mean += glm::dvec3(positions[i]);
+    mean /= double(count);
+    double covariance[3][3] = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::dvec3 offset = glm::dvec3(positions[i]) - mean;
+        for (int j = 0; j < 3; j++)
+            for (int k = 0; k < 3; k++)
+                covariance[j][k] += offset[j] * offset[k];
+    }
+
+    // Its eigenvectors are the principal axes
+    double vectors[3][3];
+    eigenvectors(covariance, vectors);
+    glm::mat3 axes;
+    for (int k = 0; k < 3; k++)
+        axes[k] = glm::normalize(glm::vec3(vectors[0][k], vectors[1][k], vectors[2][k]));
+
+    // Project the positions onto the axes
+    glm::mat3 toAxes = glm::transpose(axes);
+    glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 projected = toAxes * positions[i];
+        low  = glm::min(low, projected);
+        high = glm::max(high, projected);
+    }
+    OrientedBox oriented = { axes * (0.5f * (low + high)), axes, 0.5f * (high - low) };
+
+    // Meshes modelled along the axes are usually better off with the
+    // axis-aligned box
+    float orientedVolume = oriented.halfExtents.x * oriented.halfExtents.y * oriented.halfExtents.z;
+    float alignedVolume  = aligned.halfExtents.x * aligned.halfExtents.y * aligned.halfExtents.z;
+    return orientedVolume < alignedVolume && !std::isnan(orientedVolume) ? oriented : aligned;
+}
+
+Bounds BoundingVolumes::transform(const Bounds &bounds, const glm::mat4 &matrix)
+{
+    glm::mat3 linear(matrix);
+    glm::vec3 translation(matrix[3]);
+    Bounds moved;
+
+    // Each half extent of the box adds its reach along every world axis
+    // (Arvo's method)
+    glm::vec3 centre = linear * (0.5f * (bounds.min + bounds.max)) + translation;
+    glm::vec3 half   = 0.5f * (bounds.max - bounds.min);
+    glm::vec3 reach  = glm::abs(linear[0]) * half.x + glm::abs(linear[1]) * half.y + glm::abs(linear[2]) * half.z;
+    moved.min = centre - reach;
+    moved.max = centre + reach;
+
+    // The sphere grows by the largest scale
+    float scale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+    moved.sphere.centre = linear * bounds.sphere.centre + translation;
+    moved.sphere.radius = bounds.sphere.radius * scale;
+
+    // The oriented box's edges can stop being square to each other under a
+    // non-uniform scale, so take axes square to each other around the first
+    // edge and add up the reach of every edge along them
+    glm::vec3 edges[3];
+    for (int k = 0; k < 3; k++)
+        edges[k] = linear * (bounds.box.axes[k] * bounds.box.halfExtents[k]);
+    glm::mat3 axes = bounds.box.axes;
+    if (glm::length(edges[0]) > 0.0f && glm::length(glm::cross(edges[0], edges[1])) > 0.0f)
+    {
+        axes[0] = glm::normalize(edges[0]);
+        axes[2] = glm::normalize(glm::cross(edges[0], edges[1]));
+        axes[1] = glm::cross(axes[2], axes[0]);
+    }
+    moved.box.centre = linear * bounds.box.centre + translation;
+    moved.box.axes   = axes;
+    for (int j = 0; j < 3; j++)
+    {
+        moved.box.halfExtents[j] = std::fabs(glm::dot(axes[j], edges[0])) + std::fabs(glm::dot(axes[j], edges[1])) +
+                                   std::fabs(glm::dot(axes[j], edges[2]));
+    }
+    return moved;
+}
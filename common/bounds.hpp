@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+// Sphere enclosing a mesh
+struct BoundingSphere
+{
+    glm::vec3 centre;
+    float     radius;
+};
+
+// Box enclosing a mesh along axes of its own: the columns of axes are unit
+// vectors and halfExtents the distances from the centre to the faces along
+// them (all zero if the box hasn't been worked out)
+struct OrientedBox
+{
+    glm::vec3 centre;
+    glm::mat3 axes;
+    glm::vec3 halfExtents;
+};
+
+// All the bounding volumes of a mesh
+struct Bounds
+{
+    glm::vec3      min, max;    // axis-aligned box
+    BoundingSphere sphere;
+    OrientedBox    box;
+};
+
+// Computation of bounding volumes from vertex positions, and moving them
+// into world space
+class BoundingVolumes
+{
+public:
+    // Axis-aligned box of the positions (SSE when it is available)
+    static void box(const glm::vec3 *positions, size_t count, glm::vec3 &min, glm::vec3 &max);
+
+    // Close to the smallest sphere around the positions: Ritter's method,
+    // starting from the farthest apart pair of the extreme points along
+    // seven directions as in EPOS, then grown to take in every position
+    static BoundingSphere sphere(const glm::vec3 *positions, size_t count);
+
+    // Grow a sphere just enough to take in more positions
+    static void grow(BoundingSphere &sphere, const glm::vec3 *positions, size_t count);
+
+    // Box along the principal axes of the positions, or the axis-aligned
+    // box if that is smaller
+    static OrientedBox orientedBox(const glm::vec3 *positions, size_t count);
+
+    // Bounds in the space a matrix of translations, rotations and scales
+    // moves them into, without going back to the vertices. The axis-aligned
+    // box is the box around the moved one, the sphere grows by the largest
+    // scale and the oriented box is exact unless a non-uniform scale skews
+    // it, when it becomes a box around the skewed one.
+    static Bounds transform(const Bounds &bounds, const glm::mat4 &matrix);
+};
@@ -0,0 +1,132 @@
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+
+#include <common/filewatcher.hpp>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    bool fileState(const std::string &path, int64_t &size, int64_t &time)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return false;
+        size = static_cast<int64_t>(info.st_size);
+#ifdef __linux__
+        // In nanoseconds, so saves within a second of each other are seen
+        time = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#else
+        time = static_cast<int64_t>(info.st_mtime);
+#endif
+        return true;
+    }
+
+#ifndef __linux__
+    // Seconds between polls of the modification times
+    const double pollInterval = 0.5;
+
+    double seconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+#endif
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+    lastPoll = seconds();
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+bool FileWatcher::watch(const std::string &path)
+{
+    if (files.count(path) > 0)
+        return true;
+    FileState state;
+    if (!fileState(path, state.size, state.time))
+        return false;
+
+#ifdef __linux__
+    // Watch the directory for files closed after writing or moved into it
+    if (fd < 0)
+        return false;
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, std::max<size_t>(slash, 1));
+    int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0)
+        return false;
+    directories[wd] = directory;
+#endif
+
+    files[path] = state;
+    return true;
+}
+
+std::vector<std::string> FileWatcher::changes()
+{
+    std::vector<std::string> changes;
+
+#ifdef __linux__
+    // Drain the events, keeping the watched files that were written
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    while (fd >= 0 && (length = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *p = buffer; p < buffer + length; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            std::map<int, std::string>::const_iterator directory = directories.find(event->wd);
+            if (event->len == 0 || directory == directories.end())
+                continue;
+            std::string path = directory->second == "/" ? "/" + std::string(event->name)
+                                                        : directory->second + "/" + event->name;
+            if (files.count(path) > 0 && std::find(changes.begin(), changes.end(), path) == changes.end())
+                changes.push_back(path);
+        }
+    }
+
+    // Writes that left the file as it was don't count
+    changes.erase(std::remove_if(changes.begin(), changes.end(),
+                                 [this](const std::string &path) { return !changed(path); }),
+                  changes.end());
+#else
+    if (seconds() - lastPoll < pollInterval)
+        return changes;
+    lastPoll = seconds();
+    for (std::map<std::string, FileState>::const_iterator it = files.begin(); it != files.end(); ++it)
+    {
+        if (changed(it->first))
+            changes.push_back(it->first);
+    }
+#endif
+
+    return changes;
+}
+
+bool FileWatcher::changed(const std::string &path)
+{
+    FileState &state = files[path];
+    int64_t size, time;
+    if (!fileState(path, size, time) || (size == state.size && time == state.time))
+        return false;
+    state.size = size;
+    state.time = time;
+    return true;
+}
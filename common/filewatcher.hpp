@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports files that have been written to. Linux uses inotify on the files'
+// directories, which catches editors that save by renaming a new file over
+// the old one. Other platforms poll the files' modification times.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    // Start watching a file, returning false if it can't be watched
+    bool watch(const std::string &path);
+
+    // Files whose size or modification time has changed since the last call,
+    // each listed once (cheap enough to call every frame)
+    std::vector<std::string> changes();
+
+private:
+    // Size and modification time of each watched file when last seen
+    struct FileState
+    {
+        int64_t size;
+        int64_t time;
+    };
+    std::map<std::string, FileState> files;
+
+#ifdef __linux__
+    int fd;
+    std::map<int, std::string> directories;   // by watch descriptor
+#else
+    double lastPoll;
+#endif
+
+    // Whether a watched file is different from when it was last seen
+    bool changed(const std::string &path);
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+};
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <common/geometrypool.hpp>
+
+namespace
+{
+    // Index ranges start on 4-byte boundaries so 16 and 32-bit indices can
+    // share the buffer
+    size_t alignIndices(size_t size)
+    {
+        return (size + 3) & ~size_t(3);
+    }
+
+    bool byFirstVertex(const GeometryRange *a, const GeometryRange *b)
+    {
+        return a->firstVertex < b->firstVertex;
+    }
+
+    bool byIndexOffset(const GeometryRange *a, const GeometryRange *b)
+    {
+        return a->indexOffset < b->indexOffset;
+    }
+}
+
+RangeAllocator::RangeAllocator(size_t capacity) : total(0), freeSpace(0)
+{
+    reset(capacity, 0);
+}
+
+bool RangeAllocator::allocate(size_t size, size_t &offset)
+{
+    if (size == 0)
+    {
+        offset = 0;
+        return true;
+    }
+
+    // Take the front of the first free block big enough
+    for (std::map<size_t, size_t>::iterator block = freeBlocks.begin(); block != freeBlocks.end(); ++block)
+    {
+        if (block->second < size)
+            continue;
+        offset = block->first;
+        size_t remaining = block->second - size;
+        freeBlocks.erase(block);
+        if (remaining > 0)
+            freeBlocks[offset + size] = remaining;
+        freeSpace -= size;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+    freeSpace += size;
+
+    // Merge with the free blocks either side
+    std::map<size_t, size_t>::iterator next = freeBlocks.lower_bound(offset);
+    if (next != freeBlocks.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = freeBlocks.erase(next);
+    }
+    if (next != freeBlocks.begin())
+    {
+        std::map<size_t, size_t>::iterator previous = next;
+        --previous;
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+    freeBlocks[offset] = size;
+}
+
+void RangeAllocator::reset(size_t capacity, size_t used)
+{
+    freeBlocks.clear();
+    total     = capacity;
+    freeSpace = capacity - used;
+    if (freeSpace > 0)
+        freeBlocks[used] = freeSpace;
+}
+
+GeometryPool::GeometryPool(const VertexLayout &layout, bool positionStream,
+                           unsigned int vertexCapacity, size_t indexCapacity)
+    : vertexLayout(layout), positionLayout(VertexLayout::positionsOf(layout)), positionStream(positionStream),
+      vertexSpace(vertexCapacity), indexSpace(alignIndices(indexCapacity)), grows(0), compactions(0)
+{
+}
+
+std::shared_ptr<GeometryRange> GeometryPool::allocate(unsigned int vertexCount, size_t indexSize)
+{
+    // Create the buffers the first time
+    if (!VAO.id())
+        rebuild(vertexSpace.capacity(), indexSpace.capacity());
+
+    // Find gaps for the mesh, packing the ranges if there is room but it is
+    // split up, and growing the buffers if there isn't
+    size_t firstVertex, indexOffset;
+    if (!fit(vertexCount, indexSize, firstVertex, indexOffset))
+    {
+        if (vertexSpace.available() >= vertexCount && indexSpace.available() >= alignIndices(indexSize))
+            compact();
+        else
+        {
+            size_t vertexCapacity = std::max(2 * vertexSpace.capacity(),
+                                             vertexSpace.capacity() - vertexSpace.available() + vertexCount);
+            size_t indexCapacity  = std::max(2 * indexSpace.capacity(),
+                                             indexSpace.capacity() - indexSpace.available() + alignIndices(indexSize));
+            rebuild(vertexCapacity, indexCapacity);
+            grows++;
+        }
+        fit(vertexCount, indexSize, firstVertex, indexOffset);
+    }
+
+    GeometryRange *range = new GeometryRange;
+    range->firstVertex = static_cast<unsigned int>(firstVertex);
+    range->vertexCount = vertexCount;
+    range->indexOffset = indexOffset;
+    range->indexSize   = indexSize;
+    ranges.insert(range);
+    return std::shared_ptr<GeometryRange>(range, [this](GeometryRange *range) { free(range); });
+}
+
+void GeometryPool::upload(const GeometryRange &range, const void *vertexData, const void *indexData)
+{
+    // Write through the copy target, which leaves the VAO bindings alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertices.id());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(range.firstVertex) * vertexLayout.stride(),
+                    size_t(range.vertexCount) * vertexLayout.stride(), vertexData);
+    if (positionStream)
+    {
+        std::vector<unsigned char> positionData;
+        VertexEncoder::extract(vertexLayout, AttributePosition, vertexData, range.vertexCount, positionData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, positions.id());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(range.firstVertex) * positionLayout.stride(),
+                        positionData.size(), positionData.data());
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indices.id());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset, range.indexSize, indexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryPool::compact()
+{
+    if (vertexSpace.blocks() <= 1 && indexSpace.blocks() <= 1)
+        return;
+    rebuild(vertexSpace.capacity(), indexSpace.capacity());
+    compactions++;
+}
+
+void GeometryPool::release()
+{
+    VAO.reset();
+    depthVAO.reset();
+    vertices.reset();
+    positions.reset();
+    indices.reset();
+}
+
+GeometryPoolStats GeometryPool::stats() const
+{
+    GeometryPoolStats stats;
+    stats.ranges         = static_cast<unsigned int>(ranges.size());
+    stats.vertexCapacity = static_cast<unsigned int>(vertexSpace.capacity());
+    stats.verticesUsed   = static_cast<unsigned int>(vertexSpace.capacity() - vertexSpace.available());
+    stats.indexCapacity  = indexSpace.capacity();
+    stats.indexBytesUsed = indexSpace.capacity() - indexSpace.available();
+    stats.freeBlocks     = static_cast<unsigned int>(vertexSpace.blocks() + indexSpace.blocks());
+    stats.grows          = grows;
+    stats.compactions    = compactions;
+    return stats;
+}
+
+void GeometryPool::report() const
+{
+    GeometryPoolStats pool = stats();
+    printf("Geometry pool: %u meshes, %u of %u vertices, %.2f of %.2f MB of indices, %u free blocks, "
+           "grown %u times, compacted %u times\n",
+           pool.ranges, pool.verticesUsed, pool.vertexCapacity,
+           pool.indexBytesUsed / 1048576.0, pool.indexCapacity / 1048576.0,
+           pool.freeBlocks, pool.grows, pool.compactions);
+}
+
+bool GeometryPool::fit(unsigned int vertexCount, size_t indexSize, size_t &firstVertex, size_t &indexOffset)
+{
+    if (!vertexSpace.allocate(vertexCount, firstVertex))
+        return false;
+    if (!indexSpace.allocate(alignIndices(indexSize), indexOffset))
+    {
+        vertexSpace.free(firstVertex, vertexCount);
+        return false;
+    }
+    return true;
+}
+
+void GeometryPool::free(GeometryRange *range)
+{
+    vertexSpace.free(range->firstVertex, range->vertexCount);
+    indexSpace.free(range->indexOffset, alignIndices(range->indexSize));
+    ranges.erase(range);
+    delete range;
+}
+
+void GeometryPool::rebuild(size_t vertexCapacity, size_t indexCapacity)
+{
+    // Create the new buffers
+    GLBuffer newVertices = GLBuffer::create(), newPositions, newIndices = GLBuffer::create();
+    newVertices.setSize(vertexCapacity * vertexLayout.stride());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVertices.id());
+    glBufferData(GL_COPY_WRITE_BUFFER, newVertices.size(), NULL, GL_STATIC_DRAW);
+    if (positionStream)
+    {
+        newPositions = GLBuffer::create();
+        newPositions.setSize(vertexCapacity * positionLayout.stride());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newPositions.id());
+        glBufferData(GL_COPY_WRITE_BUFFER, newPositions.size(), NULL, GL_STATIC_DRAW);
+    }
+    newIndices.setSize(indexCapacity);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newIndices.id());
+    glBufferData(GL_COPY_WRITE_BUFFER, newIndices.size(), NULL, GL_STATIC_DRAW);
+
+    // Copy the vertices of each range, in order, to the start of the new buffers
+    std::vector<GeometryRange *> sorted(ranges.begin(), ranges.end());
+    std::sort(sorted.begin(), sorted.end(), byFirstVertex);
+    size_t vertexEnd = 0;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        GeometryRange &range = *sorted[i];
+        unsigned int stride = vertexLayout.stride();
+        glBindBuffer(GL_COPY_READ_BUFFER, vertices.id());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newVertices.id());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, size_t(range.firstVertex) * stride,
+                            vertexEnd * stride, size_t(range.vertexCount) * stride);
+        if (positionStream)
+        {
+            stride = positionLayout.stride();
+            glBindBuffer(GL_COPY_READ_BUFFER, positions.id());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, newPositions.id());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, size_t(range.firstVertex) * stride,
+                                vertexEnd * stride, size_t(range.vertexCount) * stride);
+        }
+        range.firstVertex = static_cast<unsigned int>(vertexEnd);
+        vertexEnd += range.vertexCount;
+    }
+
+    // And their indices
+    std::sort(sorted.begin(), sorted.end(), byIndexOffset);
+    size_t indexEnd = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, indices.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newIndices.id());
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        GeometryRange &range = *sorted[i];
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.indexOffset, indexEnd, range.indexSize);
+        range.indexOffset = indexEnd;
+        indexEnd += alignIndices(range.indexSize);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // Swap them in, freeing the old ones
+    vertices  = std::move(newVertices);
+    positions = std::move(newPositions);
+    indices   = std::move(newIndices);
+    vertexSpace.reset(vertexCapacity, vertexEnd);
+    indexSpace.reset(indexCapacity, indexEnd);
+
+    // Point the vertex arrays at the new buffers
+    if (!VAO.id())
+        VAO = GLVertexArray::create();
+    GLObjects::bindVertexArray(VAO.id());
+    glBindBuffer(GL_ARRAY_BUFFER, vertices.id());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.id());
+    vertexLayout.apply();
+    if (positionStream)
+    {
+        if (!depthVAO.id())
+            depthVAO = GLVertexArray::create();
+        GLObjects::bindVertexArray(depthVAO.id());
+        glBindBuffer(GL_ARRAY_BUFFER, positions.id());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.id());
+        positionLayout.apply();
+    }
+    GLObjects::bindVertexArray(0);
+}
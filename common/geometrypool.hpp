@@ -0,0 +1,124 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+
+#include <common/globject.hpp>
+#include <common/vertexformat.hpp>
+
+// Where one mesh lives in a GeometryPool. The offsets change when the pool
+// is compacted or grown, so read them when drawing rather than keeping them.
+struct GeometryRange
+{
+    unsigned int firstVertex;   // base vertex added to the mesh's indices
+    unsigned int vertexCount;
+    size_t       indexOffset;   // byte offset of the indices (4-byte aligned)
+    size_t       indexSize;     // bytes of index data
+};
+
+// Use of a GeometryPool
+struct GeometryPoolStats
+{
+    unsigned int ranges;            // meshes in the pool
+    unsigned int vertexCapacity;    // vertices and index bytes the buffers hold
+    unsigned int verticesUsed;
+    size_t       indexCapacity;
+    size_t       indexBytesUsed;
+    unsigned int freeBlocks;        // gaps in the vertex and index buffers
+    unsigned int grows;             // times the buffers were reallocated
+    unsigned int compactions;       // times the ranges were packed to close gaps
+};
+
+// First fit allocator of ranges of [0, capacity), keeping a list of free
+// blocks that are merged with their neighbours when ranges are freed
+class RangeAllocator
+{
+public:
+    RangeAllocator(size_t capacity = 0);
+
+    // Take size units, returning false if no free block is big enough
+    bool allocate(size_t size, size_t &offset);
+
+    // Give back a range
+    void free(size_t offset, size_t size);
+
+    // Start again with [0, used) taken and the rest in one free block
+    void reset(size_t capacity, size_t used);
+
+    size_t capacity() const { return total; }
+    size_t available() const { return freeSpace; }
+    size_t blocks() const { return freeBlocks.size(); }
+
+private:
+    std::map<size_t, size_t> freeBlocks;    // offset to size
+    size_t total, freeSpace;
+};
+
+// Shared vertex and index buffers that meshes with the same vertex layout
+// are packed into, drawn with glDrawElementsBaseVertex behind one VAO so
+// drawing different meshes doesn't need a VAO bind each. Indices of each
+// mesh keep their own type. Freed ranges are reused first fit, and the
+// buffers are compacted when a mesh doesn't fit in any gap but would fit in
+// the free space, and grown when it wouldn't. Use on the GL thread only.
+class GeometryPool
+{
+public:
+    // Constructor (the buffers are created when the first mesh is added and
+    // start at the given capacities). A pool with a position stream also
+    // keeps the positions in a buffer and VAO of their own for depth passes.
+    GeometryPool(const VertexLayout &layout, bool positionStream = false,
+                 unsigned int vertexCapacity = 1 << 16, size_t indexCapacity = 1 << 20);
+
+    // Vertex layout meshes in the pool must have
+    const VertexLayout &layout() const { return vertexLayout; }
+    bool hasPositionStream() const { return positionStream; }
+
+    // Reserve room for a mesh. The range is freed when the last reference
+    // goes, so the pool must outlive the models in it.
+    std::shared_ptr<GeometryRange> allocate(unsigned int vertexCount, size_t indexSize);
+
+    // Fill a range with interleaved vertex data and indices
+    void upload(const GeometryRange &range, const void *vertexData, const void *indexData);
+
+    // Pack the ranges at the start of the buffers, closing the gaps left by
+    // meshes that have gone
+    void compact();
+
+    // Delete the buffers and vertex arrays, once every model in the pool has
+    // gone, while the context is still current (they are made again if
+    // another mesh is added)
+    void release();
+
+    // Buffers and vertex arrays (0 until the first mesh is added)
+    unsigned int vertexArray() const { return VAO.id(); }
+    unsigned int depthVertexArray() const { return depthVAO.id(); }
+    unsigned int vertexBuffer() const { return vertices.id(); }
+    unsigned int positionBuffer() const { return positions.id(); }
+    unsigned int indexBuffer() const { return indices.id(); }
+
+    // Current use, and print it
+    GeometryPoolStats stats() const;
+    void report() const;
+
+private:
+    VertexLayout vertexLayout;
+    VertexLayout positionLayout;
+    bool positionStream;
+
+    GLVertexArray VAO, depthVAO;
+    GLBuffer vertices, positions, indices;
+    RangeAllocator vertexSpace, indexSpace;
+    std::set<GeometryRange *> ranges;
+    unsigned int grows, compactions;
+
+    // Take room for a mesh if there is a gap big enough for it
+    bool fit(unsigned int vertexCount, size_t indexSize, size_t &firstVertex, size_t &indexOffset);
+
+    // Give a range back when the last reference to it goes
+    void free(GeometryRange *range);
+
+    // Move the ranges into new buffers of the given capacities, packed at the
+    // start, and point the vertex arrays at them
+    void rebuild(size_t vertexCapacity, size_t indexCapacity);
+};
@@ -0,0 +1,117 @@
+#include <atomic>
+#include <cstdio>
+
+#include <GL/glew.h>
+
+#include <common/globject.hpp>
+
+namespace
+{
+    std::atomic<unsigned int> liveObjects[GLObjectTypeCount];
+    std::atomic<size_t>       liveBytes[GLObjectTypeCount];
+
+    // Vertex array bound through bindVertexArray() and the binds made
+    unsigned int boundVertexArray = 0;
+    unsigned int vertexArrayBindCount = 0;
+}
+
+GLObjectCount GLObjects::count(GLObjectType type)
+{
+    GLObjectCount count;
+    count.objects = liveObjects[type];
+    count.bytes   = liveBytes[type];
+    return count;
+}
+
+void GLObjects::report()
+{
+    printf("Live GL objects: %u buffers (%.2f MB), %u vertex arrays, %u textures (%.2f MB), %u programs\n",
+           liveObjects[GLObjectBuffer].load(), liveBytes[GLObjectBuffer] / 1048576.0,
+           liveObjects[GLObjectVertexArray].load(),
+           liveObjects[GLObjectTexture].load(), liveBytes[GLObjectTexture] / 1048576.0,
+           liveObjects[GLObjectProgram].load());
+}
+
+unsigned int GLObjects::generate(GLObjectType type)
+{
+    unsigned int name = 0;
+    switch (type)
+    {
+    case GLObjectBuffer:
+        glGenBuffers(1, &name);
+        break;
+    case GLObjectVertexArray:
+        glGenVertexArrays(1, &name);
+        break;
+    case GLObjectTexture:
+        glGenTextures(1, &name);
+        break;
+    case GLObjectProgram:
+        name = glCreateProgram();
+        break;
+    default:
+        break;
+    }
+    if (name != 0)
+        liveObjects[type]++;
+    return name;
+}
+
+void GLObjects::adopted(GLObjectType type)
+{
+    liveObjects[type]++;
+}
+
+void GLObjects::destroy(GLObjectType type, unsigned int name, size_t bytes)
+{
+    switch (type)
+    {
+    case GLObjectBuffer:
+        glDeleteBuffers(1, &name);
+        break;
+    case GLObjectVertexArray:
+        glDeleteVertexArrays(1, &name);
+        if (name == boundVertexArray)
+            boundVertexArray = 0;
+        break;
+    case GLObjectTexture:
+        glDeleteTextures(1, &name);
+        break;
+    case GLObjectProgram:
+        glDeleteProgram(name);
+        break;
+    default:
+        break;
+    }
+    liveObjects[type]--;
+    liveBytes[type] -= bytes;
+}
+
+void GLObjects::resized(GLObjectType type, size_t from, size_t to)
+{
+    liveBytes[type] += to;
+    liveBytes[type] -= from;
+}
+
+void GLObjects::bindVertexArray(unsigned int name)
+{
+    if (name == boundVertexArray)
+        return;
+    glBindVertexArray(name);
+    boundVertexArray = name;
+    if (name != 0)
+        vertexArrayBindCount++;
+}
+
+void GLObjects::forgetVertexArray()
+{
+    // No vertex array has the name ~0, so whatever is asked for next is bound
+    boundVertexArray = ~0u;
+}
+
+unsigned int GLObjects::vertexArrayBinds()
+{
+    unsigned int binds = vertexArrayBindCount;
+    vertexArrayBindCount = 0;
+    return binds;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+
+// Kinds of OpenGL object owned by a GLObject
+enum GLObjectType
+{
+    GLObjectBuffer,
+    GLObjectVertexArray,
+    GLObjectTexture,
+    GLObjectProgram,
+    GLObjectTypeCount
+};
+
+// Live objects of one kind and the bytes of GPU memory recorded against them
+struct GLObjectCount
+{
+    unsigned int objects;
+    size_t       bytes;
+};
+
+// Counters of live OpenGL objects, kept by GLObject
+class GLObjects
+{
+public:
+    // Current count for one kind of object
+    static GLObjectCount count(GLObjectType type);
+
+    // Print the live objects of each kind
+    static void report();
+
+    // Create and delete objects, keeping the counts
+    static unsigned int generate(GLObjectType type);
+    static void adopted(GLObjectType type);
+    static void destroy(GLObjectType type, unsigned int name, size_t bytes);
+    static void resized(GLObjectType type, size_t from, size_t to);
+
+    // Bind a vertex array unless it is already bound. Models bind through
+    // this and leave their vertex array bound after drawing, so consecutive
+    // draws from the same one (or the same GeometryPool) don't rebind.
+    static void bindVertexArray(unsigned int name);
+
+    // Forget which vertex array is bound so the next bindVertexArray() binds.
+    // Call after binding one with glBindVertexArray() directly, which the
+    // cache can't see.
+    static void forgetVertexArray();
+
+    // Vertex arrays bound, other than 0, since the last call
+    static unsigned int vertexArrayBinds();
+};
+
+// Sole owner of an OpenGL object, deleting it when destroyed. Objects can be
+// moved but not copied, so copying anything that holds one is a compile error.
+template <GLObjectType type>
+class GLObject
+{
+public:
+    // Empty (owns nothing)
+    GLObject() : name(0), bytes(0) {}
+
+    // Take ownership of an existing object
+    explicit GLObject(unsigned int name) : name(name), bytes(0)
+    {
+        if (name != 0)
+            GLObjects::adopted(type);
+    }
+
+    // Generate a new object
+    static GLObject create() { GLObject object; object.name = GLObjects::generate(type); return object; }
+
+    GLObject(GLObject &&other) : name(other.name), bytes(other.bytes)
+    {
+        other.name  = 0;
+        other.bytes = 0;
+    }
+
+    GLObject &operator=(GLObject &&other)
+    {
+        if (this != &other)
+        {
+            reset();
+            name        = other.name;
+            bytes       = other.bytes;
+            other.name  = 0;
+            other.bytes = 0;
+        }
+        return *this;
+    }
+
+    GLObject(const GLObject &) = delete;
+    GLObject &operator=(const GLObject &) = delete;
+
+    ~GLObject() { reset(); }
+
+    // Object name (0 if empty)
+    const unsigned int &id() const { return name; }
+
+    // Bytes of GPU memory the object holds, as recorded with setSize()
+    size_t size() const { return bytes; }
+    void setSize(size_t size)
+    {
+        GLObjects::resized(type, bytes, size);
+        bytes = size;
+    }
+
+    // Delete the object, leaving this empty
+    void reset()
+    {
+        if (name != 0)
+            GLObjects::destroy(type, name, bytes);
+        name  = 0;
+        bytes = 0;
+    }
+
+private:
+    unsigned int name;
+    size_t bytes;
+};
+
+typedef GLObject<GLObjectBuffer>      GLBuffer;
+typedef GLObject<GLObjectVertexArray> GLVertexArray;
+typedef GLObject<GLObjectTexture>     GLTexture;
+typedef GLObject<GLObjectProgram>     GLProgram;
@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <common/gltf.hpp>
+
+namespace
+{
+    // Deepest nesting of JSON values and of scene nodes followed
+    const int maxDepth = 64;
+
+    const uint32_t glbMagic     = 0x46546C67;  // "glTF"
+    const uint32_t glbJsonChunk = 0x4E4F534A;  // "JSON"
+    const uint32_t glbBinChunk  = 0x004E4942;  // "BIN\0"
+
+    uint32_t readWord(const char *p)
+    {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        return word;
+    }
+
+    void skipSpace(const char *&p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    // Append a code point to a string as UTF-8
+    void appendUtf8(std::string &text, unsigned int code)
+    {
+        if (code < 0x80)
+            text += static_cast<char>(code);
+        else if (code < 0x800)
+        {
+            text += static_cast<char>(0xC0 | (code >> 6));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            text += static_cast<char>(0xE0 | (code >> 12));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            text += static_cast<char>(0xF0 | (code >> 18));
+            text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parseHex4(const char *&p, const char *end, unsigned int &code)
+    {
+        if (end - p < 4)
+            return false;
+        char digits[5] = { p[0], p[1], p[2], p[3], 0 };
+        char *last;
+        code = static_cast<unsigned int>(strtoul(digits, &last, 16));
+        p += 4;
+        return last == digits + 4;
+    }
+
+    bool parseString(const char *&p, const char *end, std::string &text)
+    {
+        // Skip the opening quote
+        p++;
+        text.clear();
+        while (p < end && *p != '"')
+        {
+            if (*p != '\\')
+            {
+                text += *p++;
+                continue;
+            }
+            if (++p == end)
+                return false;
+            char escape = *p++;
+            switch (escape)
+            {
+                case '"':  text += '"';  break;
+                case '\\': text += '\\'; break;
+                case '/':  text += '/';  break;
+                case 'b':  text += '\b'; break;
+                case 'f':  text += '\f'; break;
+                case 'n':  text += '\n'; break;
+                case 'r':  text += '\r'; break;
+                case 't':  text += '\t'; break;
+                case 'u':
+                {
+                    unsigned int code, low;
+                    if (!parseHex4(p, end, code))
+                        return false;
+                    if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                    {
+                        p += 2;
+                        if (!parseHex4(p, end, low))
+                            return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(text, code);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        if (p == end)
+            return false;
+        p++;
+        return true;
+    }
+
+    // Size in bytes of a component type
+    unsigned int componentSize(GLenum type)
+    {
+        switch (type)
+        {
+            case GL_BYTE:
+            case GL_UNSIGNED_BYTE:  return 1;
+            case GL_SHORT:
+            case GL_UNSIGNED_SHORT: return 2;
+            case GL_UNSIGNED_INT:
+            case GL_FLOAT:          return 4;
+        }
+        return 0;
+    }
+
+    // Components of an accessor type
+    unsigned int typeComponents(const std::string &type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2")   return 2;
+        if (type == "VEC3")   return 3;
+        if (type == "VEC4")   return 4;
+        if (type == "MAT2")   return 4;
+        if (type == "MAT3")   return 9;
+        if (type == "MAT4")   return 16;
+        return 0;
+    }
+
+    // Read one component as a float
+    float readComponent(const unsigned char *p, GLenum type, bool normalised)
+    {
+        switch (type)
+        {
+            case GL_FLOAT:
+            {
+                float value;
+                memcpy(&value, p, sizeof(value));
+                return value;
+            }
+            case GL_BYTE:
+            {
+                float value = static_cast<float>(*reinterpret_cast<const signed char *>(p));
+                return normalised ? glm::max(value / 127.0f, -1.0f) : value;
+            }
+            case GL_UNSIGNED_BYTE:
+                return normalised ? *p / 255.0f : static_cast<float>(*p);
+            case GL_SHORT:
+            {
+                short value;
+                memcpy(&value, p, sizeof(value));
+                return normalised ? glm::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+            }
+            case GL_UNSIGNED_SHORT:
+            {
+                unsigned short value;
+                memcpy(&value, p, sizeof(value));
+                return normalised ? value / 65535.0f : static_cast<float>(value);
+            }
+            case GL_UNSIGNED_INT:
+            {
+                unsigned int value;
+                memcpy(&value, p, sizeof(value));
+                return normalised ? static_cast<float>(value / 4294967295.0) : static_cast<float>(value);
+            }
+        }
+        return 0.0f;
+    }
+
+    // Transform of a node relative to its parent
+    glm::mat4 nodeTransform(const Json &node)
+    {
+        glm::mat4 transform(1.0f);
+        const Json &matrix = node["matrix"];
+        if (matrix.size() == 16)
+        {
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    transform[column][row] = static_cast<float>(matrix[4 * column + row].number());
+            return transform;
+        }
+
+        // Translation, rotation (x, y, z, w) and scale, applied scale first
+        const Json &translation = node["translation"];
+        const Json &rotation    = node["rotation"];
+        const Json &scale       = node["scale"];
+        if (translation.size() == 3)
+            transform[3] = glm::vec4(translation[0].number(), translation[1].number(), translation[2].number(), 1.0f);
+        if (rotation.size() == 4)
+        {
+            glm::quat q(static_cast<float>(rotation[3].number()), static_cast<float>(rotation[0].number()),
+                        static_cast<float>(rotation[1].number()), static_cast<float>(rotation[2].number()));
+            glm::mat3 turn = glm::mat3_cast(q);
+            for (int column = 0; column < 3; column++)
+                transform[column] = glm::vec4(turn[column], 0.0f);
+        }
+        if (scale.size() == 3)
+            for (int column = 0; column < 3; column++)
+                transform[column] *= static_cast<float>(scale[column].number(1.0));
+        return transform;
+    }
+
+    const Json nullValue;
+}
+
+bool Json::parse(const char *begin, const char *end)
+{
+    const char *p = begin;
+    if (!parseValue(p, end, 0))
+        return false;
+    skipSpace(p, end);
+    return p == end;
+}
+
+const Json &Json::operator[](const char *key) const
+{
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] == key)
+            return elements[i];
+    return nullValue;
+}
+
+const Json &Json::operator[](int index) const
+{
+    return valueType == Array && index >= 0 && size_t(index) < elements.size() ? elements[index] : nullValue;
+}
+
+double Json::number(double fallback) const
+{
+    return valueType == Number || valueType == Boolean ? numberValue : fallback;
+}
+
+bool Json::parseValue(const char *&p, const char *end, int depth)
+{
+    skipSpace(p, end);
+    if (p == end || depth > maxDepth)
+        return false;
+
+    // Objects and arrays
+    if (*p == '{' || *p == '[')
+    {
+        bool object = *p == '{';
+        char close  = object ? '}' : ']';
+        valueType   = object ? Object : Array;
+        p++;
+        skipSpace(p, end);
+        if (p < end && *p == close)
+        {
+            p++;
+            return true;
+        }
+        while (p < end)
+        {
+            if (object)
+            {
+                std::string key;
+                if (*p != '"' || !parseString(p, end, key))
+                    return false;
+                skipSpace(p, end);
+                if (p == end || *p++ != ':')
+                    return false;
+                keys.push_back(key);
+            }
+            elements.push_back(Json());
+            if (!elements.back().parseValue(p, end, depth + 1))
+                return false;
+            skipSpace(p, end);
+            if (p == end)
+                return false;
+            if (*p == close)
+            {
+                p++;
+                return true;
+            }
+            if (*p++ != ',')
+                return false;
+            skipSpace(p, end);
+        }
+        return false;
+    }
+
+    // Strings
+    if (*p == '"')
+    {
+        valueType = String;
+        return parseString(p, end, text);
+    }
+
+    // Literals
+    const char *literals[] = { "true", "false", "null" };
+    for (int i = 0; i < 3; i++)
+    {
+        size_t length = strlen(literals[i]);
+        if (size_t(end - p) >= length && strncmp(p, literals[i], length) == 0)
+        {
+            valueType   = i < 2 ? Boolean : Null;
+            numberValue = i == 0 ? 1.0 : 0.0;
+            p += length;
+            return true;
+        }
+    }
+
+    // Numbers, copied out since the text needn't be null terminated
+    char digits[64];
+    size_t length = 0;
+    while (p + length < end && length < sizeof(digits) - 1 && strchr("+-0123456789.eE", p[length]) != NULL)
+        length++;
+    if (length == 0)
+        return false;
+    memcpy(digits, p, length);
+    digits[length] = 0;
+    char *last;
+    valueType   = Number;
+    numberValue = strtod(digits, &last);
+    p += length;
+    return last == digits + length;
+}
+
+bool GltfFile::open(const char *path)
+{
+    mapping = std::make_shared<MappedFile>();
+    binary     = NULL;
+    binarySize = 0;
+    if (!mapping->open(path))
+    {
+        printf("Couldn't open %s\n", path);
+        return false;
+    }
+
+    // Header, then a JSON chunk and an optional binary chunk
+    const char *data = mapping->data();
+    size_t size = mapping->size();
+    if (size < 20 || readWord(data) != glbMagic || readWord(data + 4) != 2)
+    {
+        printf("%s isn't a binary glTF 2.0 file\n", path);
+        return false;
+    }
+    size = std::min<size_t>(size, readWord(data + 8));
+    size_t offset = 12;
+    bool hasJson = false;
+    while (offset + 8 <= size)
+    {
+        size_t length = readWord(data + offset);
+        uint32_t type = readWord(data + offset + 4);
+        const char *chunk = data + offset + 8;
+        if (length > size - offset - 8)
+            break;
+        if (type == glbJsonChunk && !hasJson)
+        {
+            if (!document.parse(chunk, chunk + length))
+            {
+                printf("%s has invalid JSON\n", path);
+                return false;
+            }
+            hasJson = true;
+        }
+        else if (type == glbBinChunk && binary == NULL)
+        {
+            binary     = reinterpret_cast<const unsigned char *>(chunk);
+            binarySize = length;
+        }
+        offset += 8 + ((length + 3) & ~size_t(3));
+    }
+    if (!hasJson)
+    {
+        printf("%s has no JSON chunk\n", path);
+        return false;
+    }
+
+    // Images in files of their own are relative to this one
+    std::string file(path);
+    size_t slash = file.find_last_of("/\\");
+    directory = slash == std::string::npos ? std::string() : file.substr(0, slash + 1);
+    return true;
+}
+
+std::vector<GltfInstance> GltfFile::instances() const
+{
+    std::vector<GltfInstance> instances;
+    const Json &scenes = document["scenes"];
+    if (scenes.size() == 0)
+    {
+        // Without a scene, draw each mesh once where it is
+        for (unsigned int mesh = 0; mesh < document["meshes"].size(); mesh++)
+        {
+            GltfInstance instance = { mesh, glm::mat4(1.0f) };
+            instances.push_back(instance);
+        }
+        return instances;
+    }
+
+    const Json &roots = scenes[document["scene"].integer(0)]["nodes"];
+    for (size_t i = 0; i < roots.size(); i++)
+        addInstances(roots[i].integer(), glm::mat4(1.0f), 0, instances);
+    return instances;
+}
+
+void GltfFile::addInstances(int node, const glm::mat4 &parent, int depth, std::vector<GltfInstance> &instances) const
+{
+    const Json &nodes = document["nodes"];
+    if (node < 0 || size_t(node) >= nodes.size() || depth > maxDepth)
+        return;
+    glm::mat4 transform = parent * nodeTransform(nodes[node]);
+    int mesh = nodes[node]["mesh"].integer();
+    if (mesh >= 0 && size_t(mesh) < document["meshes"].size())
+    {
+        GltfInstance instance = { static_cast<unsigned int>(mesh), transform };
+        instances.push_back(instance);
+    }
+    const Json &children = nodes[node]["children"];
+    for (size_t i = 0; i < children.size(); i++)
+        addInstances(children[i].integer(), transform, depth + 1, instances);
+}
+
+std::vector<GltfPrimitive> GltfFile::primitives(unsigned int mesh) const
+{
+    const char *names[AttributeCount] = { "POSITION", "TEXCOORD_0", "NORMAL", "TANGENT", "" };
+    std::vector<GltfPrimitive> primitives;
+    const Json &list = document["meshes"][mesh]["primitives"];
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        // Triangle lists only
+        if (list[i]["mode"].integer(4) != 4)
+            continue;
+        GltfPrimitive primitive;
+        for (int attribute = 0; attribute < AttributeCount; attribute++)
+            primitive.attributes[attribute] = list[i]["attributes"][names[attribute]].integer();
+        primitive.indices  = list[i]["indices"].integer();
+        primitive.material = list[i]["material"].integer();
+        if (primitive.attributes[AttributePosition] >= 0)
+            primitives.push_back(primitive);
+    }
+    return primitives;
+}
+
+bool GltfFile::accessor(int index, GltfAccessor &accessor) const
+{
+    const Json &description = document["accessors"][index];
+    const Json &view = document["bufferViews"][description["bufferView"].integer()];
+    if (index < 0 || view.isNull() || view["buffer"].integer(0) != 0 || binary == NULL ||
+        !description["sparse"].isNull())
+        return false;
+
+    accessor.count         = static_cast<unsigned int>(description["count"].number());
+    accessor.components    = typeComponents(description["type"].string());
+    accessor.componentType = static_cast<GLenum>(description["componentType"].integer(0));
+    accessor.normalised    = description["normalized"].number() != 0.0;
+    size_t elementSize = size_t(accessor.components) * componentSize(accessor.componentType);
+    size_t viewOffset  = static_cast<size_t>(view["byteOffset"].number());
+    size_t viewLength  = static_cast<size_t>(view["byteLength"].number());
+    size_t offset      = static_cast<size_t>(description["byteOffset"].number());
+    accessor.stride = static_cast<size_t>(view["byteStride"].number(static_cast<double>(elementSize)));
+    accessor.offset = viewOffset + offset;
+    accessor.data   = binary + accessor.offset;
+
+    // Check it is all inside the view and the view is inside the chunk
+    if (elementSize == 0 || viewOffset > binarySize || viewLength > binarySize - viewOffset)
+        return false;
+    if (accessor.count == 0)
+        return offset <= viewLength;
+    return offset <= viewLength &&
+           (accessor.count - 1) * accessor.stride + elementSize <= viewLength - offset;
+}
+
+bool GltfFile::readFloats(int index, unsigned int components, std::vector<float> &data) const
+{
+    GltfAccessor source;
+    if (!accessor(index, source))
+        return false;
+    unsigned int size = componentSize(source.componentType);
+    unsigned int shared = std::min(components, source.components);
+    data.assign(size_t(source.count) * components, 0.0f);
+    for (unsigned int i = 0; i < source.count; i++)
+    {
+        const unsigned char *element = source.data + i * source.stride;
+        for (unsigned int c = 0; c < shared; c++)
+            data[size_t(i) * components + c] = readComponent(element + c * size, source.componentType, source.normalised);
+    }
+    return true;
+}
+
+bool GltfFile::readIndices(int index, std::vector<unsigned int> &indices) const
+{
+    GltfAccessor source;
+    if (!accessor(index, source) || source.components != 1 || source.componentType == GL_FLOAT)
+        return false;
+    indices.resize(source.count);
+    for (unsigned int i = 0; i < source.count; i++)
+        indices[i] = static_cast<unsigned int>(readComponent(source.data + i * source.stride, source.componentType, false));
+    return true;
+}
+
+int GltfFile::materialTexture(int material, const char *name) const
+{
+    const Json &description = document["materials"][material];
+    if (material < 0 || description.isNull())
+        return -1;
+    if (strcmp(name, "baseColorTexture") == 0)
+        return description["pbrMetallicRoughness"][name]["index"].integer();
+    return description[name]["index"].integer();
+}
+
+bool GltfFile::textureImage(int texture, const unsigned char *&data, size_t &size, std::string &path) const
+{
+    data = NULL;
+    size = 0;
+    path.clear();
+    int source = document["textures"][texture]["source"].integer();
+    const Json &image = document["images"][source];
+    if (texture < 0 || source < 0 || image.isNull())
+        return false;
+
+    // Embedded in a buffer view
+    const Json &view = document["bufferViews"][image["bufferView"].integer()];
+    if (!view.isNull())
+    {
+        size_t offset = static_cast<size_t>(view["byteOffset"].number());
+        size_t length = static_cast<size_t>(view["byteLength"].number());
+        if (binary == NULL || offset > binarySize || length > binarySize - offset)
+            return false;
+        data = binary + offset;
+        size = length;
+        return true;
+    }
+
+    // In a file of its own (data URIs aren't supported)
+    const std::string &uri = image["uri"].string();
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+        return false;
+    path = directory + uri;
+    return true;
+}
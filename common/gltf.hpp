@@ -0,0 +1,122 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/mappedfile.hpp>
+#include <common/vertexformat.hpp>
+
+// Value in a JSON document
+class Json
+{
+public:
+    enum Type { Null, Boolean, Number, String, Array, Object };
+
+    Json() : valueType(Null), numberValue(0.0) {}
+
+    // Parse a document, returning false if it isn't valid JSON
+    bool parse(const char *begin, const char *end);
+
+    Type type() const { return valueType; }
+    bool isNull() const { return valueType == Null; }
+
+    // Member of an object or element of an array (null if there isn't one)
+    const Json &operator[](const char *key) const;
+    const Json &operator[](int index) const;
+
+    // Elements of an array or members of an object
+    size_t size() const { return elements.size(); }
+
+    // Value of a number or boolean, or a string (fallback or empty for
+    // values of other types)
+    double number(double fallback = 0.0) const;
+    int integer(int fallback = -1) const { return static_cast<int>(number(fallback)); }
+    const std::string &string() const { return text; }
+
+private:
+    Type valueType;
+    double numberValue;
+    std::string text;
+    std::vector<Json> elements;         // array elements or object member values
+    std::vector<std::string> keys;      // object member names
+
+    bool parseValue(const char *&p, const char *end, int depth);
+};
+
+// Accessor of a glTF file resolved to where its data is in the binary chunk
+struct GltfAccessor
+{
+    const unsigned char *data;      // first element
+    size_t       offset;            // of the first element from the start of the binary chunk
+    size_t       stride;            // bytes from one element to the next
+    unsigned int count;
+    unsigned int components;        // 1 for scalars up to 16 for mat4
+    GLenum       componentType;     // GL_FLOAT, GL_UNSIGNED_SHORT etc.
+    bool         normalised;
+};
+
+// Triangles of one glTF mesh primitive, as accessor indices (-1 if missing)
+struct GltfPrimitive
+{
+    int attributes[AttributeCount];
+    int indices;
+    int material;
+};
+
+// Mesh drawn by a node of the scene and the node's transform to the scene
+struct GltfInstance
+{
+    unsigned int mesh;
+    glm::mat4 transform;
+};
+
+// Memory mapped binary glTF 2.0 (.glb) file. Data has to be in the file's
+// binary chunk, apart from images which can also be files of their own.
+class GltfFile
+{
+public:
+    // Map a file and parse its JSON chunk
+    bool open(const char *path);
+
+    // Mapping of the whole file, for keeping data pointed into alive
+    std::shared_ptr<MappedFile> file() const { return mapping; }
+    const Json &json() const { return document; }
+
+    // Meshes drawn by the default scene, in node order
+    std::vector<GltfInstance> instances() const;
+
+    // Triangle primitives of a mesh
+    std::vector<GltfPrimitive> primitives(unsigned int mesh) const;
+
+    // Find an accessor's data, returning false if it isn't in the binary chunk
+    bool accessor(int index, GltfAccessor &accessor) const;
+
+    // Read the first components components of each element as floats,
+    // scaling normalised integers (missing components read as 0)
+    bool readFloats(int accessor, unsigned int components, std::vector<float> &data) const;
+
+    // Read indices of any integer type
+    bool readIndices(int accessor, std::vector<unsigned int> &indices) const;
+
+    // Texture of a material: "baseColorTexture" or "normalTexture" (-1 if
+    // it hasn't got one)
+    int materialTexture(int material, const char *name) const;
+
+    // Image of a texture, either embedded (data and size) or in a file
+    // (path, relative to the working directory)
+    bool textureImage(int texture, const unsigned char *&data, size_t &size, std::string &path) const;
+
+private:
+    std::shared_ptr<MappedFile> mapping;
+    std::string directory;
+    Json document;
+    const unsigned char *binary;
+    size_t binarySize;
+
+    // Add a node's mesh and those of its children
+    void addInstances(int node, const glm::mat4 &parent, int depth, std::vector<GltfInstance> &instances) const;
+};
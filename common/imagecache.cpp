@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <common/archive.hpp>
+#include <common/imagecache.hpp>
+#include <common/mappedfile.hpp>
+
+namespace
+{
+    const char magic[4] = { 'I', 'M', 'G', 'C' };
+
+    // Data blocks are aligned so the mapped pointers can be used directly
+    const uint64_t blockAlignment = 64;
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + blockAlignment - 1) & ~(blockAlignment - 1);
+    }
+
+    // Counts shared by every thread that decodes
+    struct Counters
+    {
+        std::atomic<unsigned int> hits;
+        std::atomic<unsigned int> misses;
+        std::atomic<uint64_t> savedMicroseconds;
+
+        Counters() : hits(0), misses(0), savedMicroseconds(0) {}
+    };
+
+    Counters &counters()
+    {
+        static Counters counters;
+        return counters;
+    }
+
+    // Size and modification time of a file
+    bool sourceInfo(const char *path, uint64_t &size, int64_t &time)
+    {
+        // Sources in the mounted archive carry the time they were packed with
+        AssetArchive *archive = AssetArchive::mounted();
+        const ArchiveEntry *entry = archive != NULL ? archive->find(path) : NULL;
+        if (entry != NULL)
+        {
+            size = entry->size;
+            time = entry->time;
+            return true;
+        }
+
+        struct stat info;
+        if (stat(path, &info) != 0)
+            return false;
+        size = static_cast<uint64_t>(info.st_size);
+        time = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+
+    uint64_t hashFile(const char *path)
+    {
+        MappedFile file(path);
+        return ImageCache::hash(file.data(), file.size());
+    }
+
+    // Create a file of our own next to a cache to write it in, so writers of
+    // the same cache on other threads or in other processes each have one
+    FILE *createTemporary(const std::string &path, std::string &temporaryPath)
+    {
+        temporaryPath = path + ".XXXXXX";
+#ifdef _WIN32
+        if (_mktemp_s(&temporaryPath[0], temporaryPath.size() + 1) != 0)
+            return NULL;
+        int descriptor = _open(temporaryPath.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+                               _S_IREAD | _S_IWRITE);
+        FILE *file = descriptor >= 0 ? _fdopen(descriptor, "wb") : NULL;
+        if (descriptor >= 0 && file == NULL)
+            _close(descriptor);
+#else
+        int descriptor = mkstemp(&temporaryPath[0]);
+        FILE *file = descriptor >= 0 ? fdopen(descriptor, "wb") : NULL;
+        if (descriptor >= 0 && file == NULL)
+            close(descriptor);
+#endif
+        if (file == NULL && descriptor >= 0)
+            remove(temporaryPath.c_str());
+        return file;
+    }
+
+    // Absolute path with links and . and .. resolved (the path as given if
+    // the file isn't on disk, e.g. if it is in the mounted archive)
+    std::string canonicalPath(const char *path)
+    {
+#ifdef _WIN32
+        char resolved[_MAX_PATH];
+        if (_fullpath(resolved, path, _MAX_PATH) != NULL)
+            return resolved;
+#else
+        char resolved[PATH_MAX];
+        if (realpath(path, resolved) != NULL)
+            return resolved;
+#endif
+        return path;
+    }
+
+    std::string &cacheDirectory()
+    {
+        static std::string directory;
+        if (directory.empty())
+        {
+            // The user's own cache directory, so no one else can put files
+            // in it for us to map
+#ifdef _WIN32
+            const char *base = getenv("LOCALAPPDATA");
+            directory = std::string(base != NULL && base[0] != 0 ? base : ".") + "\\imagecache";
+#else
+            const char *base = getenv("XDG_CACHE_HOME");
+            const char *home = getenv("HOME");
+            if (base != NULL && base[0] == '/')
+                directory = std::string(base) + "/imagecache";
+            else if (home != NULL && home[0] == '/')
+                directory = std::string(home) + "/.cache/imagecache";
+            else
+            {
+                const char *temporary = getenv("TMPDIR");
+                char user[32];
+                snprintf(user, sizeof(user), "/imagecache-%u", unsigned(getuid()));
+                directory = std::string(temporary != NULL && temporary[0] != 0 ? temporary : "/tmp") + user;
+            }
+#endif
+        }
+        return directory;
+    }
+
+    // Whether the cache directory is one only we can write to, making it
+    // (and its parent, e.g. ~/.cache) first if asked to
+    bool directoryUsable(const std::string &directory, bool create)
+    {
+#ifdef _WIN32
+        if (create)
+            _mkdir(directory.c_str());
+        struct _stat info;
+        return _stat(directory.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR) != 0;
+#else
+        if (create)
+        {
+            size_t slash = directory.find_last_of('/');
+            if (slash != std::string::npos && slash > 0)
+                mkdir(directory.substr(0, slash).c_str(), 0700);
+            mkdir(directory.c_str(), 0700);
+        }
+        struct stat info;
+        return lstat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode) && info.st_uid == getuid() &&
+               (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#endif
+    }
+}
+
+std::string ImageCache::directory()
+{
+    return cacheDirectory();
+}
+
+void ImageCache::setDirectory(const char *path)
+{
+    cacheDirectory() = path;
+}
+
+std::string ImageCache::cachePath(const char *sourcePath, bool flip, int components, MipmapFilter mipmaps)
+{
+    // Name the cache after the source, to tell them apart, and a hash of its
+    // full path and the decode, to keep them apart
+    std::string source = canonicalPath(sourcePath);
+    char decode[32];
+    snprintf(decode, sizeof(decode), "|%d,%d,%d", int(flip), components, int(mipmaps));
+    source += decode;
+    std::string name = sourcePath;
+    name = name.substr(name.find_last_of("/\\") + 1);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.imagecache",
+             static_cast<unsigned long long>(hash(source.data(), source.size())));
+    return directory() + "/" + name + suffix;
+}
+
+bool ImageCache::open(const char *sourcePath, bool flip, int components, MipmapFilter mipmaps, DecodedImage &image)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t size;
+    int64_t time;
+    if (!sourceInfo(sourcePath, size, time))
+        return false;
+
+    if (!directoryUsable(directory(), false))
+        return false;
+    std::string path = cachePath(sourcePath, flip, components, mipmaps);
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path.c_str()) || file->size() < sizeof(ImageCacheHeader))
+        return false;
+
+    // Check the header describes the decode asked for and data that is
+    // actually in the file
+    const ImageCacheHeader *header = reinterpret_cast<const ImageCacheHeader *>(file->data());
+    uint64_t pixelBytes = uint64_t(header->width) * header->height * header->components;
+    uint64_t mipmapBytes = header->mipmapFilter != MipmapDriver ?
+                           Mipmaps::chainSize(header->width, header->height, header->components) : 0;
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version ||
+        header->flip != uint32_t(flip) || header->requestedComponents != components ||
+        header->mipmapFilter != uint32_t(mipmaps) || header->width <= 0 || header->height <= 0 ||
+        header->components < 1 || header->components > 4 ||
+        header->pixelOffset + pixelBytes > header->mipmapOffset ||
+        header->mipmapOffset + mipmapBytes > file->size())
+        return false;
+
+    // The cache is stale if the source has changed size. If only the time has
+    // changed (e.g. a fresh checkout) compare the contents and keep the cache
+    // if they match, recording the new time so we don't hash it again.
+    if (header->sourceSize != size)
+        return false;
+    if (header->sourceTime != time)
+    {
+        if (hashFile(sourcePath) != header->sourceHash)
+            return false;
+
+        FILE *out = fopen(path.c_str(), "r+b");
+        if (out != NULL)
+        {
+            fseek(out, offsetof(ImageCacheHeader, sourceTime), SEEK_SET);
+            fwrite(&time, sizeof(time), 1, out);
+            fclose(out);
+        }
+    }
+
+    // Point into the mapping, which GL only reads from
+    unsigned char *data = reinterpret_cast<unsigned char *>(const_cast<char *>(file->data()));
+    image.width      = header->width;
+    image.height     = header->height;
+    image.components = header->components;
+    image.pixels     = std::shared_ptr<unsigned char>(file, data + header->pixelOffset);
+    image.mipmaps    = mipmapBytes > 0 ? std::shared_ptr<unsigned char>(file, data + header->mipmapOffset)
+                                       : std::shared_ptr<unsigned char>();
+
+    double openTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    double saved = header->decodeTime - openTime;
+    counters().hits++;
+    counters().savedMicroseconds += saved > 0.0 ? static_cast<uint64_t>(saved * 1000.0) : 0;
+    return true;
+}
+
+bool ImageCache::write(const char *sourcePath, bool flip, int components, MipmapFilter mipmaps,
+                       const DecodedImage &image, double decodeTime)
+{
+    counters().misses++;
+
+    // Describe the source file and the decode
+    ImageCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    if (!image.pixels || !sourceInfo(sourcePath, header.sourceSize, header.sourceTime))
+        return false;
+    header.sourceHash          = hashFile(sourcePath);
+    header.width               = image.width;
+    header.height              = image.height;
+    header.components          = image.components;
+    header.requestedComponents = components;
+    header.flip                = flip;
+    header.mipmapFilter        = mipmaps;
+    header.decodeTime          = static_cast<float>(decodeTime);
+
+    // Lay out the data blocks
+    uint64_t pixelBytes  = uint64_t(image.width) * image.height * image.components;
+    uint64_t mipmapBytes = image.mipmaps ? Mipmaps::chainSize(image.width, image.height, image.components) : 0;
+    header.pixelOffset  = alignUp(sizeof(ImageCacheHeader));
+    header.mipmapOffset = alignUp(header.pixelOffset + pixelBytes);
+
+    // Write to a temporary file and move it into place so a reader never
+    // sees a partially written cache
+    std::string path = cachePath(sourcePath, flip, components, mipmaps);
+    if (!directoryUsable(directory(), true))
+    {
+        printf("Not caching images in %s, which isn't a directory only this user can write to\n",
+               directory().c_str());
+        return false;
+    }
+    std::string temporaryPath;
+    FILE *file = createTemporary(path, temporaryPath);
+    if (file == NULL)
+        return false;
+
+    std::vector<char> padding(blockAlignment, 0);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(padding.data(), 1, header.pixelOffset - sizeof(header), file) == header.pixelOffset - sizeof(header);
+    ok = ok && fwrite(image.pixels.get(), 1, pixelBytes, file) == pixelBytes;
+    ok = ok && fwrite(padding.data(), 1, header.mipmapOffset - header.pixelOffset - pixelBytes, file) == header.mipmapOffset - header.pixelOffset - pixelBytes;
+    ok = ok && fwrite(image.mipmaps.get(), 1, mipmapBytes, file) == mipmapBytes;
+    ok = fclose(file) == 0 && ok;
+
+    if (ok)
+    {
+        remove(path.c_str());
+        ok = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+        remove(temporaryPath.c_str());
+
+    return ok;
+}
+
+uint64_t ImageCache::hash(const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+ImageCacheStats ImageCache::stats()
+{
+    ImageCacheStats stats;
+    stats.hits      = counters().hits;
+    stats.misses    = counters().misses;
+    stats.savedTime = counters().savedMicroseconds / 1000.0;
+    return stats;
+}
+
+void ImageCache::report()
+{
+    ImageCacheStats total = stats();
+    unsigned int requests = total.hits + total.misses;
+    printf("Image cache: %u of %u decodes mapped from cache (%.0f%%), %.1f ms of decoding saved\n", total.hits,
+           requests, requests > 0 ? 100.0 * total.hits / requests : 0.0, total.savedTime);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include <common/imagedecoder.hpp>
+
+// Header at the start of a decoded image cache file. The pixels and the mip
+// levels below them follow at the given byte offsets.
+struct ImageCacheHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint64_t sourceHash;
+    int32_t  width;
+    int32_t  height;
+    int32_t  components;            // of the cached pixels
+    int32_t  requestedComponents;   // asked of the decoder (0 keeps the file's)
+    uint32_t flip;
+    uint32_t mipmapFilter;          // asked for (no mip levels are cached for MipmapDriver or a 1x1 image)
+    float    decodeTime;            // milliseconds decoding took, which a hit saves
+    uint32_t reserved;
+    uint64_t pixelOffset;
+    uint64_t mipmapOffset;
+};
+
+// Counts kept by the ImageCache
+struct ImageCacheStats
+{
+    unsigned int hits;              // images mapped from a cache
+    unsigned int misses;            // images decoded and cached
+    double       savedTime;         // milliseconds of decoding the hits saved
+};
+
+// Binary cache of decoded images, so later runs map the pixels and mip
+// levels rather than decoding them. Caches are kept in a directory of their
+// own, out of the source tree, as <source name>.<hash>.imagecache where the
+// hash is of the source's full path and the decode (flip, channel count and
+// mip filter), so each decode of a file has a cache of its own. A cache is
+// invalidated when the contents of its source change. Safe on any thread.
+class ImageCache
+{
+public:
+    // Bump whenever the layout or the decoding of the cached data changes
+    static const uint32_t version = 2;
+
+    // Directory the caches are kept in, made when the first is written. It
+    // defaults to imagecache in the user's cache directory ($XDG_CACHE_HOME,
+    // ~/.cache or %LOCALAPPDATA%). Caches are neither read nor written if
+    // the directory isn't the user's own or others can write to it. Set it
+    // before loading any images.
+    static std::string directory();
+    static void setDirectory(const char *path);
+
+    // Path of the cache file for a decode of a source file
+    static std::string cachePath(const char *sourcePath, bool flip, int components, MipmapFilter mipmaps);
+
+    // Map the cache for a source file if it holds the decode asked for,
+    // pointing the image at the mapped pixels (which keep the file mapped)
+    static bool open(const char *sourcePath, bool flip, int components, MipmapFilter mipmaps, DecodedImage &image);
+
+    // Write the cache for a source file's decoded image
+    static bool write(const char *sourcePath, bool flip, int components, MipmapFilter mipmaps,
+                      const DecodedImage &image, double decodeTime);
+
+    // 64-bit FNV-1a hash of a block of memory
+    static uint64_t hash(const void *data, size_t size);
+
+    // Counts since startup
+    static ImageCacheStats stats();
+
+    // Print the hit rate and the time saved
+    static void report();
+};
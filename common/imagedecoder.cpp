@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <chrono>
+
+#include <common/archive.hpp>
+#include <common/imagecache.hpp>
+#include <common/imagedecoder.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#include <common/stb_image.hpp>
+#include <common/threadpool.hpp>
+
+ImageDecoder::ImageDecoder()
+{
+    queue       = std::make_shared<Queue>();
+    nextId      = 0;
+    outstanding = 0;
+}
+
+DecodedImage ImageDecoder::decode(const char *path, bool flip, int components, MipmapFilter mipmaps, bool cached)
+{
+    DecodedImage image = { 0, 0, 0, std::shared_ptr<unsigned char>(), std::shared_ptr<unsigned char>() };
+    if (cached && ImageCache::open(path, flip, components, mipmaps, image))
+        return image;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string file;
+    if (!readAsset(path, file))
+        return image;
+    image = decode(reinterpret_cast<const unsigned char *>(file.data()), file.size(), flip, components, mipmaps);
+    if (cached && image.pixels)
+    {
+        double decodeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!ImageCache::write(path, flip, components, mipmaps, image, decodeTime))
+            printf("Couldn't write %s\n", ImageCache::cachePath(path, flip, components, mipmaps).c_str());
+    }
+    return image;
+}
+
+DecodedImage ImageDecoder::decode(const unsigned char *data, size_t size, bool flip, int components,
+                                  MipmapFilter mipmaps)
+{
+    // The thread's own flip setting overrides the global one for good, so
+    // every decode sets it
+    DecodedImage image = { 0, 0, 0, std::shared_ptr<unsigned char>(), std::shared_ptr<unsigned char>() };
+    int fileComponents = 0;
+    stbi_set_flip_vertically_on_load_thread(flip);
+    unsigned char *pixels = stbi_load_from_memory(data, static_cast<int>(size), &image.width, &image.height,
+                                                  &fileComponents, components);
+    if (pixels == NULL)
+        return image;
+    image.components = components > 0 ? components : fileComponents;
+    image.pixels     = std::shared_ptr<unsigned char>(pixels, stbi_image_free);
+
+    // Build the mip chain while still off the GL thread
+    size_t chainSize = Mipmaps::chainSize(image.width, image.height, image.components);
+    if (mipmaps != MipmapDriver && chainSize > 0)
+    {
+        image.mipmaps = std::shared_ptr<unsigned char>(new unsigned char[chainSize], std::default_delete<unsigned char[]>());
+        Mipmaps::build(pixels, image.width, image.height, image.components, mipmaps, image.mipmaps.get());
+    }
+    return image;
+}
+
+unsigned int ImageDecoder::submit(const std::string &path, bool flip, int components, MipmapFilter mipmaps,
+                                  bool cached)
+{
+    unsigned int id = nextId++;
+    outstanding++;
+    std::shared_ptr<Queue> queue = this->queue;
+    ThreadPool::shared().submit([queue, id, path, flip, components, mipmaps, cached]()
+    {
+        DecodedImage image = decode(path.c_str(), flip, components, mipmaps, cached);
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->images.push_back(std::make_pair(id, image));
+        }
+        queue->decoded.notify_one();
+    });
+    return id;
+}
+
+bool ImageDecoder::next(unsigned int &id, DecodedImage &image, bool wait)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (wait && outstanding > 0)
+        queue->decoded.wait(lock, [this]() { return !queue->images.empty(); });
+    if (queue->images.empty())
+        return false;
+    id    = queue->images.front().first;
+    image = queue->images.front().second;
+    queue->images.pop_front();
+    outstanding--;
+    return true;
+}
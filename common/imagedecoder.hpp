@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <common/mipmaps.hpp>
+
+// Pixels of a decoded image, starting at the bottom row if it was flipped
+struct DecodedImage
+{
+    int width, height, components;
+    std::shared_ptr<unsigned char> pixels;      // empty if it couldn't be decoded
+    std::shared_ptr<unsigned char> mipmaps;     // levels below the full image one after another, if built
+};
+
+// Decodes images with stb_image on the shared thread pool, leaving them in a
+// queue for the GL thread to upload. The vertical flip is set on the thread
+// doing each decode rather than globally, so decodes that flip and decodes
+// that don't can run at once.
+class ImageDecoder
+{
+public:
+    ImageDecoder();
+
+    // Decode an image file (from the mounted archive if it is in there), or
+    // an image in memory, on the calling thread. Mip levels are built too
+    // unless the filter is MipmapDriver. Files are mapped from their
+    // ImageCache instead if cached is set and it holds them, and cached
+    // after decoding if it doesn't.
+    static DecodedImage decode(const char *path, bool flip, int components = 0,
+                               MipmapFilter mipmaps = MipmapDriver, bool cached = false);
+    static DecodedImage decode(const unsigned char *data, size_t size, bool flip, int components = 0,
+                               MipmapFilter mipmaps = MipmapDriver);
+
+    // Start decoding a file on the thread pool, returning the id its image
+    // will be queued under
+    unsigned int submit(const std::string &path, bool flip, int components = 0,
+                        MipmapFilter mipmaps = MipmapDriver, bool cached = false);
+
+    // Take a decoded image from the queue, waiting for one if wait is set and
+    // some are still decoding. Returns false if there was none to take.
+    bool next(unsigned int &id, DecodedImage &image, bool wait);
+
+    // Number of images submitted and not yet taken
+    unsigned int pending() const { return outstanding; }
+
+private:
+    // Decoded images, shared with the tasks so they can finish after the
+    // decoder is gone
+    struct Queue
+    {
+        std::mutex mutex;
+        std::condition_variable decoded;
+        std::deque<std::pair<unsigned int, DecodedImage> > images;
+    };
+    std::shared_ptr<Queue> queue;
+
+    unsigned int nextId;
+    unsigned int outstanding;
+
+    ImageDecoder(const ImageDecoder &) = delete;
+    ImageDecoder &operator=(const ImageDecoder &) = delete;
+};
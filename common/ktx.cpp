@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <fstream>
+
+#include <common/archive.hpp>
+#include <common/ktx.hpp>
+#include <common/mipmaps.hpp>
+
+namespace
+{
+    const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const uint32_t ktxEndianness = 0x04030201;
+
+    // Images are stored bottom row first, as they are uploaded
+    const char orientationKey[] = "KTXorientation";
+    const char orientationValue[] = "S=r,T=u";
+
+    size_t padded(size_t size)
+    {
+        return (size + 3) & ~size_t(3);
+    }
+}
+
+bool KtxFile::isKtx(const char *path)
+{
+    size_t length = strlen(path);
+    return length > 4 && (strcmp(path + length - 4, ".ktx") == 0 || strcmp(path + length - 4, ".KTX") == 0);
+}
+
+bool KtxFile::read(const char *path, CompressedTexture &texture)
+{
+    std::string file;
+    if (!readAsset(path, file))
+        return false;
+    return read(reinterpret_cast<const unsigned char *>(file.data()), file.size(), texture, path);
+}
+
+bool KtxFile::read(const unsigned char *data, size_t size, CompressedTexture &texture, const char *name)
+{
+    KtxHeader header;
+    if (size < sizeof(header))
+    {
+        printf("%s is too short to be a KTX file\n", name);
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0 || header.endianness != ktxEndianness)
+    {
+        printf("%s isn't a little endian KTX file\n", name);
+        return false;
+    }
+
+    // Only block compressed 2D textures are written by texcompress
+    int format = 0;
+    while (format < BlockFormatCount &&
+           BlockCompression::internalFormat(BlockFormat(format)) != header.glInternalFormat)
+        format++;
+    if (format == BlockFormatCount || header.pixelDepth > 1 || header.numberOfArrayElements > 0 ||
+        header.numberOfFaces != 1 || header.pixelWidth == 0 || header.pixelHeight == 0 ||
+        header.pixelWidth > INT_MAX || header.pixelHeight > INT_MAX)
+    {
+        printf("%s isn't a block compressed 2D texture (format 0x%X)\n", name, header.glInternalFormat);
+        return false;
+    }
+    texture.format = BlockFormat(format);
+    texture.width  = static_cast<int>(header.pixelWidth);
+    texture.height = static_cast<int>(header.pixelHeight);
+
+    // A full chain ends at 1x1, so a file can't hold more levels than that
+    unsigned int levelCount = std::max(header.numberOfMipmapLevels, uint32_t(1));
+    if (levelCount > unsigned(Mipmaps::levelCount(texture.width, texture.height)) + 1)
+    {
+        printf("%s has %u mip levels, more than a %dx%d texture can have\n", name, levelCount,
+               texture.width, texture.height);
+        return false;
+    }
+
+    // Read each level, checking its size against its dimensions
+    size_t offset = sizeof(header) + header.bytesOfKeyValueData;
+    texture.levels.assign(levelCount, std::vector<unsigned char>());
+    for (unsigned int level = 0; level < levelCount; level++)
+    {
+        int width = std::max(texture.width >> level, 1), height = std::max(texture.height >> level, 1);
+        size_t expected = BlockCompression::imageSize(texture.format, width, height);
+        uint32_t imageSize = 0;
+        if (offset + sizeof(imageSize) <= size)
+            memcpy(&imageSize, data + offset, sizeof(imageSize));
+        offset += sizeof(imageSize);
+        if (imageSize != expected || offset + imageSize > size)
+        {
+            printf("%s is truncated or corrupt at mip level %u\n", name, level);
+            return false;
+        }
+        texture.levels[level].assign(data + offset, data + offset + imageSize);
+        offset += padded(imageSize);
+    }
+    return true;
+}
+
+bool KtxFile::write(const char *path, const CompressedTexture &texture)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // Key/value data is the orientation, a size then a null terminated key
+    // and value, padded
+    uint32_t pairSize = sizeof(orientationKey) + sizeof(orientationValue);
+    std::vector<char> keyValues(padded(sizeof(pairSize) + pairSize), 0);
+    memcpy(&keyValues[0], &pairSize, sizeof(pairSize));
+    memcpy(&keyValues[sizeof(pairSize)], orientationKey, sizeof(orientationKey));
+    memcpy(&keyValues[sizeof(pairSize) + sizeof(orientationKey)], orientationValue, sizeof(orientationValue));
+
+    KtxHeader header;
+    memcpy(header.identifier, ktxIdentifier, sizeof(ktxIdentifier));
+    header.endianness            = ktxEndianness;
+    header.glType                = 0;
+    header.glTypeSize            = 1;
+    header.glFormat              = 0;
+    header.glInternalFormat      = BlockCompression::internalFormat(texture.format);
+    header.glBaseInternalFormat  = BlockCompression::baseFormat(texture.format);
+    header.pixelWidth            = static_cast<uint32_t>(texture.width);
+    header.pixelHeight           = static_cast<uint32_t>(texture.height);
+    header.pixelDepth            = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces         = 1;
+    header.numberOfMipmapLevels  = static_cast<uint32_t>(texture.levels.size());
+    header.bytesOfKeyValueData   = static_cast<uint32_t>(keyValues.size());
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(&keyValues[0], keyValues.size());
+
+    const char padding[4] = { 0, 0, 0, 0 };
+    for (size_t level = 0; level < texture.levels.size(); level++)
+    {
+        uint32_t imageSize = static_cast<uint32_t>(texture.levels[level].size());
+        file.write(reinterpret_cast<const char *>(&imageSize), sizeof(imageSize));
+        file.write(reinterpret_cast<const char *>(texture.levels[level].data()), imageSize);
+        file.write(padding, padded(imageSize) - imageSize);
+    }
+    return file.good();
+}
+
+size_t KtxFile::size(const CompressedTexture &texture)
+{
+    size_t size = 0;
+    for (size_t level = 0; level < texture.levels.size(); level++)
+        size += texture.levels[level].size();
+    return size;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <common/blockcompression.hpp>
+
+// Start of a KTX 1 file, followed by key/value data and then each mip level
+// as its size and its data, each padded to 4 bytes
+struct KtxHeader
+{
+    unsigned char identifier[12];       // «KTX 11»\r\n\x1A\n
+    uint32_t endianness;                // 0x04030201 as written
+    uint32_t glType;                    // 0 for compressed formats
+    uint32_t glTypeSize;
+    uint32_t glFormat;                  // 0 for compressed formats
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;                // 0 for 2D textures
+    uint32_t numberOfArrayElements;     // 0 if not an array
+    uint32_t numberOfFaces;             // 1 if not a cube map
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+// Block compressed 2D texture with its mip levels, largest first. Rows start
+// at the bottom, as OpenGL expects and as loadTexture() flips images to.
+struct CompressedTexture
+{
+    BlockFormat format;
+    int width, height;
+    std::vector<std::vector<unsigned char> > levels;
+};
+
+// Reading and writing of KTX files holding block compressed textures
+class KtxFile
+{
+public:
+    // Whether a path names a KTX file
+    static bool isKtx(const char *path);
+
+    // Read a file (from the mounted archive if it is in there), or a file in
+    // memory, printing why if it isn't a block compressed 2D texture
+    static bool read(const char *path, CompressedTexture &texture);
+    static bool read(const unsigned char *data, size_t size, CompressedTexture &texture, const char *name);
+
+    // Write a texture
+    static bool write(const char *path, const CompressedTexture &texture);
+
+    // Bytes of all the levels of a texture
+    static size_t size(const CompressedTexture &texture);
+};
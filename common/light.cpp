@@ -61,7 +61,7 @@ void Light::toShader(unsigned int shaderID, glm::mat4 view)
     }
 }
 
-void Light::draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Model lightModel)
+void Light::draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Model &lightModel)
 {
     glUseProgram(shaderID);
     for (unsigned int i = 0; i < static_cast<unsigned int>(lightSources.size()); i++)
@@ -83,6 +83,6 @@ void Light::draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Mo
         glUniform3fv(glGetUniformLocation(shaderID, "lightColour"), 1, &lightSources[i].colour[0]);
 
         // Draw light source
-        lightModel.draw(shaderID);
+        lightModel.drawDepth(shaderID);
     }
 }
@@ -35,5 +35,5 @@ public:
     void toShader(unsigned int shaderID, glm::mat4 view);
     
     // Draw light source
-    void draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Model lightModel);
+    void draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Model &lightModel);
 };
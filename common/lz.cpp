@@ -0,0 +1,141 @@
+#include <cstring>
+
+#include <common/lz.hpp>
+
+namespace
+{
+    const unsigned int minMatch  = 4;
+    const unsigned int maxOffset = 65535;
+    const unsigned int hashBits  = 16;
+
+    unsigned int read32(const unsigned char *p)
+    {
+        unsigned int value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    unsigned int hash4(const unsigned char *p)
+    {
+        return (read32(p) * 2654435761u) >> (32 - hashBits);
+    }
+
+    // Lengths of 15 or more continue in bytes of 255 and a final byte
+    void writeLength(std::vector<unsigned char> &out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back(static_cast<unsigned char>(length));
+    }
+
+    bool readLength(const unsigned char *&p, const unsigned char *end, size_t &length)
+    {
+        unsigned char byte;
+        do
+        {
+            if (p == end)
+                return false;
+            byte = *p++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    void writeSequence(std::vector<unsigned char> &out, const unsigned char *literals, size_t literalCount,
+                       size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength - minMatch;
+        unsigned char token = static_cast<unsigned char>((literalCount < 15 ? literalCount : 15) << 4);
+        if (matchLength > 0)
+            token |= static_cast<unsigned char>(matchCode < 15 ? matchCode : 15);
+        out.push_back(token);
+        if (literalCount >= 15)
+            writeLength(out, literalCount - 15);
+        out.insert(out.end(), literals, literals + literalCount);
+        if (matchLength == 0)
+            return;
+        out.push_back(static_cast<unsigned char>(offset & 0xFF));
+        out.push_back(static_cast<unsigned char>(offset >> 8));
+        if (matchCode >= 15)
+            writeLength(out, matchCode - 15);
+    }
+}
+
+void Lz::compress(const void *data, size_t size, std::vector<unsigned char> &out)
+{
+    const unsigned char *input = static_cast<const unsigned char *>(data);
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+
+    // Most recent position of each hashed 4 bytes, greedily taking the
+    // longest match there. The last sequence is all literals.
+    std::vector<size_t> table(size_t(1) << hashBits, size_t(-1));
+    size_t anchor = 0, i = 0;
+    while (size >= minMatch && i + minMatch <= size)
+    {
+        unsigned int h = hash4(input + i);
+        size_t candidate = table[h];
+        table[h] = i;
+        if (candidate == size_t(-1) || i - candidate > maxOffset || read32(input + candidate) != read32(input + i))
+        {
+            i++;
+            continue;
+        }
+
+        size_t length = minMatch;
+        while (i + length < size && input[candidate + length] == input[i + length])
+            length++;
+        writeSequence(out, input + anchor, i - anchor, i - candidate, length);
+
+        // Hash a couple of the matched positions so runs keep matching
+        for (size_t j = i + 1; j < i + length && j + minMatch <= size && j < i + 3; j++)
+            table[hash4(input + j)] = j;
+        i += length;
+        anchor = i;
+    }
+    writeSequence(out, input + anchor, size - anchor, 0, 0);
+}
+
+bool Lz::decompress(const void *data, size_t size, void *out, size_t outSize)
+{
+    const unsigned char *p   = static_cast<const unsigned char *>(data);
+    const unsigned char *end = p + size;
+    unsigned char *output = static_cast<unsigned char *>(out);
+    size_t written = 0;
+    while (p < end)
+    {
+        // Literals
+        unsigned char token = *p++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(p, end, literals))
+            return false;
+        if (literals > size_t(end - p) || literals > outSize - written)
+            return false;
+        memcpy(output + written, p, literals);
+        p += literals;
+        written += literals;
+        if (p == end)
+            break;
+
+        // Match, copied forwards byte by byte when it overlaps itself
+        if (end - p < 2)
+            return false;
+        size_t offset = p[0] | (size_t(p[1]) << 8);
+        p += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(p, end, length))
+            return false;
+        length += minMatch;
+        if (offset == 0 || offset > written || length > outSize - written)
+            return false;
+        unsigned char *target = output + written;
+        const unsigned char *source = target - offset;
+        if (offset >= length)
+            memcpy(target, source, length);
+        else
+            for (size_t k = 0; k < length; k++)
+                target[k] = source[k];
+        written += length;
+    }
+    return written == outSize;
+}
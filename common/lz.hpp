@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Byte-oriented LZ77 compression in the style of LZ4: each sequence is a
+// token holding the lengths of a run of literals and of the match after
+// them, the literals, and the match's 16-bit backwards offset. Fast to
+// decode, for blocks that are decompressed when assets are loaded.
+class Lz
+{
+public:
+    // Compress size bytes, replacing the contents of out
+    static void compress(const void *data, size_t size, std::vector<unsigned char> &out);
+
+    // Decompress into exactly outSize bytes, returning false if the data is
+    // corrupt or doesn't decompress to that size
+    static bool decompress(const void *data, size_t size, void *out, size_t outSize);
+};
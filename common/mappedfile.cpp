@@ -0,0 +1,160 @@
+#include <common/archive.hpp>
+#include <common/mappedfile.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    fileData = NULL;
+    fileSize = 0;
+    opened   = false;
+    mapped   = false;
+#ifdef _WIN32
+    fileHandle    = NULL;
+    mappingHandle = NULL;
+#endif
+}
+
+MappedFile::MappedFile(const char *path) : MappedFile()
+{
+    open(path);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+
+    // Files in the mounted archive don't touch the filesystem
+    AssetArchive *archive = AssetArchive::mounted();
+    if (archive != NULL && archive->open(path, *this))
+        return true;
+    return map(path);
+}
+
+bool MappedFile::map(const char *path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // Empty files can't be mapped but are still valid files
+    fileHandle = file;
+    fileSize   = static_cast<size_t>(size.QuadPart);
+    opened     = true;
+    if (fileSize == 0)
+        return true;
+
+    mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle != NULL)
+        fileData = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (fileData == NULL)
+    {
+        close();
+        return false;
+    }
+    mapped = true;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // Empty files can't be mapped but are still valid files
+    fileSize = static_cast<size_t>(info.st_size);
+    opened   = true;
+    if (fileSize == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void *address = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+    {
+        fileSize = 0;
+        opened   = false;
+        return false;
+    }
+
+    // Files are mostly parsed front to back so ask for aggressive read-ahead
+    madvise(address, fileSize, MADV_SEQUENTIAL);
+    fileData = static_cast<const char *>(address);
+    mapped   = true;
+#endif
+
+    return true;
+}
+
+void MappedFile::release(const char *begin, size_t size)
+{
+    // Decompressed files are ordinary memory, which dropping would zero
+    if (!buffer.empty())
+        return;
+
+#ifdef _WIN32
+    // Unlocking pages that aren't locked takes them out of the working set
+    VirtualUnlock(const_cast<char *>(begin), size);
+#else
+    // Only whole pages inside the range can be dropped
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t first = (reinterpret_cast<size_t>(begin) + pageSize - 1) & ~(pageSize - 1);
+    size_t last  = (reinterpret_cast<size_t>(begin) + size) & ~(pageSize - 1);
+    if (first < last)
+        madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED);
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (mapped && fileData != NULL)
+        UnmapViewOfFile(fileData);
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    if (fileHandle != NULL)
+        CloseHandle(fileHandle);
+    fileHandle    = NULL;
+    mappingHandle = NULL;
+#else
+    if (mapped && fileData != NULL)
+        munmap(const_cast<char *>(fileData), fileSize);
+#endif
+    std::vector<char>().swap(buffer);
+
+    fileData = NULL;
+    fileSize = 0;
+    opened   = false;
+    mapped   = false;
+}
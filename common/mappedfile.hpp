@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// Read-only memory mapped view of a whole file. If an asset archive is
+// mounted, files it holds are opened from it instead.
+class MappedFile
+{
+public:
+    // Constructors
+    MappedFile();
+    MappedFile(const char *path);
+
+    // Destructor unmaps the file
+    ~MappedFile();
+
+    // Map and unmap a file
+    bool open(const char *path);
+    void close();
+
+    // Map a file from disk even if the mounted archive has it
+    bool map(const char *path);
+
+    // Let the OS drop the pages of a range that won't be read again, so
+    // reading a large file front to back doesn't fill memory with it
+    void release(const char *begin, size_t size);
+
+    // File contents
+    const char *data() const { return fileData; }
+    size_t size() const      { return fileSize; }
+    bool isOpen() const      { return opened; }
+
+private:
+    const char *fileData;
+    size_t fileSize;
+    bool opened;
+    bool mapped;                // false for views of an archive and decompressed files
+    std::vector<char> buffer;   // contents of a decompressed file
+
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+
+    friend class AssetArchive;
+
+    // Mappings can't be shared
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
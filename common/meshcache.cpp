@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <vector>
+
+#include <common/archive.hpp>
+#include <common/meshcache.hpp>
+
+namespace
+{
+    const char magic[4] = { 'M', 'S', 'H', 'C' };
+
+    // Data blocks are aligned so the mapped pointers can be used directly
+    const uint64_t blockAlignment = 64;
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + blockAlignment - 1) & ~(blockAlignment - 1);
+    }
+
+    // Size and modification time of a file
+    bool sourceInfo(const char *path, uint64_t &size, int64_t &time)
+    {
+        // Sources in the mounted archive carry the time they were packed with
+        AssetArchive *archive = AssetArchive::mounted();
+        const ArchiveEntry *entry = archive != NULL ? archive->find(path) : NULL;
+        if (entry != NULL)
+        {
+            size = entry->size;
+            time = entry->time;
+            return true;
+        }
+
+        struct stat info;
+        if (stat(path, &info) != 0)
+            return false;
+        size = static_cast<uint64_t>(info.st_size);
+        time = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+
+    uint64_t hashFile(const char *path)
+    {
+        MappedFile file(path);
+        return MeshCache::hash(file.data(), file.size());
+    }
+
+    // Create a file of our own next to a cache to write it in, so writers of
+    // the same cache on other threads or in other processes each have one
+    FILE *createTemporary(const std::string &path, std::string &temporaryPath)
+    {
+        temporaryPath = path + ".XXXXXX";
+#ifdef _WIN32
+        if (_mktemp_s(&temporaryPath[0], temporaryPath.size() + 1) != 0)
+            return NULL;
+        int descriptor = _open(temporaryPath.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+                               _S_IREAD | _S_IWRITE);
+        FILE *file = descriptor >= 0 ? _fdopen(descriptor, "wb") : NULL;
+        if (descriptor >= 0 && file == NULL)
+            _close(descriptor);
+#else
+        int descriptor = mkstemp(&temporaryPath[0]);
+        FILE *file = descriptor >= 0 ? fdopen(descriptor, "wb") : NULL;
+        if (descriptor >= 0 && file == NULL)
+            close(descriptor);
+#endif
+        if (file == NULL && descriptor >= 0)
+            remove(temporaryPath.c_str());
+        return file;
+    }
+}
+
+std::string MeshCache::cachePath(const char *sourcePath, const std::string &settings)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.meshcache",
+             static_cast<unsigned long long>(hash(settings.data(), settings.size())));
+    return std::string(sourcePath) + suffix;
+}
+
+const MeshCacheHeader *MeshCache::open(const char *sourcePath, const std::string &settings, MappedFile &file)
+{
+    uint64_t size;
+    int64_t time;
+    if (!sourceInfo(sourcePath, size, time))
+        return NULL;
+
+    std::string path = cachePath(sourcePath, settings);
+    if (!file.open(path.c_str()) || file.size() < sizeof(MeshCacheHeader))
+        return NULL;
+
+    // Check the header describes data that is actually in the file, with
+    // indices of a type GL can draw
+    const MeshCacheHeader *header = reinterpret_cast<const MeshCacheHeader *>(file.data());
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version ||
+        (header->indexSize != 2 && header->indexSize != 4) ||
+        header->lodCount > maxLods || header->indexOffset < header->vertexOffset ||
+        header->vertexOffset + uint64_t(header->vertexCount) * header->vertexStride > header->indexOffset ||
+        header->indexOffset + uint64_t(header->indexCount) * header->indexSize > header->meshletOffset ||
+        header->meshletOffset + uint64_t(header->meshletCount) * header->meshletSize > file.size())
+    {
+        file.close();
+        return NULL;
+    }
+    for (uint32_t i = 0; i < header->lodCount; i++)
+    {
+        if (uint64_t(header->lods[i].indexOffset) + header->lods[i].indexCount > header->indexCount)
+        {
+            file.close();
+            return NULL;
+        }
+    }
+
+    // The cache is stale if the source has changed size. If only the time has
+    // changed (e.g. a fresh checkout) compare the contents and keep the cache
+    // if they match, recording the new time so we don't hash it again.
+    if (header->sourceSize != size)
+    {
+        file.close();
+        return NULL;
+    }
+    if (header->sourceTime != time)
+    {
+        if (hashFile(sourcePath) != header->sourceHash)
+        {
+            file.close();
+            return NULL;
+        }
+
+        FILE *out = fopen(path.c_str(), "r+b");
+        if (out != NULL)
+        {
+            fseek(out, offsetof(MeshCacheHeader, sourceTime), SEEK_SET);
+            fwrite(&time, sizeof(time), 1, out);
+            fclose(out);
+        }
+    }
+
+    return header;
+}
+
+bool MeshCache::write(const char *sourcePath, const std::string &settings, MeshCacheHeader header,
+                      const void *vertexData, const void *indexData,
+                      const void *meshletData)
+{
+    // Describe the source file
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    if (!sourceInfo(sourcePath, header.sourceSize, header.sourceTime))
+        return false;
+    header.sourceHash = hashFile(sourcePath);
+
+    // Lay out the data blocks
+    uint64_t vertexBytes = uint64_t(header.vertexCount) * header.vertexStride;
+    uint64_t indexBytes  = uint64_t(header.indexCount) * header.indexSize;
+    uint64_t meshletBytes = meshletData != NULL ? uint64_t(header.meshletCount) * header.meshletSize : 0;
+    header.vertexOffset  = alignUp(sizeof(MeshCacheHeader));
+    header.indexOffset   = alignUp(header.vertexOffset + vertexBytes);
+    header.meshletOffset = alignUp(header.indexOffset + indexBytes);
+    if (meshletData == NULL)
+        header.meshletCount = 0;
+
+    // Write to a temporary file and move it into place so a reader never
+    // sees a partially written cache
+    std::string path = cachePath(sourcePath, settings);
+    std::string temporaryPath;
+    FILE *file = createTemporary(path, temporaryPath);
+    if (file == NULL)
+        return false;
+
+    std::vector<char> padding(blockAlignment, 0);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(padding.data(), 1, header.vertexOffset - sizeof(header), file) == header.vertexOffset - sizeof(header);
+    ok = ok && fwrite(vertexData, 1, vertexBytes, file) == vertexBytes;
+    ok = ok && fwrite(padding.data(), 1, header.indexOffset - header.vertexOffset - vertexBytes, file) == header.indexOffset - header.vertexOffset - vertexBytes;
+    ok = ok && fwrite(indexData, 1, indexBytes, file) == indexBytes;
+    ok = ok && fwrite(padding.data(), 1, header.meshletOffset - header.indexOffset - indexBytes, file) == header.meshletOffset - header.indexOffset - indexBytes;
+    ok = ok && fwrite(meshletData, 1, meshletBytes, file) == meshletBytes;
+    ok = fclose(file) == 0 && ok;
+
+    if (ok)
+    {
+        remove(path.c_str());
+        ok = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+        remove(temporaryPath.c_str());
+
+    return ok;
+}
+
+uint64_t MeshCache::hash(const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include <common/mappedfile.hpp>
+
+// Range of the cached indices holding one level of detail
+struct MeshCacheLod
+{
+    float    level;
+    float    error;
+    uint32_t indexOffset;
+    uint32_t indexCount;
+};
+
+// Header at the start of a binary mesh cache file. The interleaved vertex
+// data, the index data and the meshlets follow at the given byte offsets.
+struct MeshCacheHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint64_t sourceHash;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t vertexFormat;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    float    sphere[4];             // centre and radius
+    uint32_t hasOrientedBox;
+    float    boxCentre[3];
+    float    boxAxes[9];            // unit axes one after another
+    float    boxHalfExtents[3];
+    uint32_t lodCount;
+    MeshCacheLod lods[8];
+    uint32_t meshletCount;
+    uint32_t meshletSize;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t meshletOffset;
+};
+
+// Binary cache of processed .obj files, stored next to the source as
+// <source>.<settings hash>.meshcache and invalidated when the source changes.
+// The settings are a description of the options the data was processed with,
+// so loads with different options keep caches of their own.
+class MeshCache
+{
+public:
+    // Bump whenever the layout or the processing of the cached data changes
+    static const uint32_t version = 7;
+
+    // Most levels of detail a cache can hold
+    static const uint32_t maxLods = 8;
+
+    // Path of the cache file for a source file processed with the given settings
+    static std::string cachePath(const char *sourcePath, const std::string &settings);
+
+    // Map the cache for a source file, returning the header if it is valid
+    static const MeshCacheHeader *open(const char *sourcePath, const std::string &settings, MappedFile &file);
+
+    // Write the cache for a source file (the source fields of the header are filled in)
+    static bool write(const char *sourcePath, const std::string &settings, MeshCacheHeader header,
+                      const void *vertexData, const void *indexData,
+                      const void *meshletData = NULL);
+
+    // 64-bit FNV-1a hash of a block of memory
+    static uint64_t hash(const void *data, size_t size);
+
+    // Pointers to the data in a mapped cache
+    static const void *vertexData(const MeshCacheHeader *header)
+    {
+        return reinterpret_cast<const char *>(header) + header->vertexOffset;
+    }
+    static const void *indexData(const MeshCacheHeader *header)
+    {
+        return reinterpret_cast<const char *>(header) + header->indexOffset;
+    }
+    static const void *meshletData(const MeshCacheHeader *header)
+    {
+        return reinterpret_cast<const char *>(header) + header->meshletOffset;
+    }
+};
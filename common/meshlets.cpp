@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cmath>
+
+#include <common/meshlets.hpp>
+
+namespace
+{
+    // How much the spread of the normals counts against a triangle, relative
+    // to each new vertex it brings into a meshlet
+    const float coneWeight = 2.0f;
+
+    // Work out the bounding sphere and normal cone of a meshlet
+    void computeBounds(Meshlet &meshlet, const std::vector<unsigned int> &indices,
+                       const std::vector<glm::vec3> &positions)
+    {
+        unsigned int begin = meshlet.indexOffset, end = meshlet.indexOffset + meshlet.indexCount;
+
+        // Sphere around the centre of the bounding box
+        glm::vec3 boundsMin = positions[indices[begin]], boundsMax = boundsMin;
+        for (unsigned int i = begin; i < end; i++)
+        {
+            boundsMin = glm::min(boundsMin, positions[indices[i]]);
+            boundsMax = glm::max(boundsMax, positions[indices[i]]);
+        }
+        meshlet.centre = 0.5f * (boundsMin + boundsMax);
+        meshlet.radius = 0.0f;
+        for (unsigned int i = begin; i < end; i++)
+            meshlet.radius = std::max(meshlet.radius, glm::length(positions[indices[i]] - meshlet.centre));
+
+        // Cone around the average of the triangle normals
+        glm::vec3 axis(0.0f);
+        for (unsigned int i = begin; i < end; i += 3)
+        {
+            glm::vec3 n = glm::cross(positions[indices[i + 1]] - positions[indices[i]],
+                                     positions[indices[i + 2]] - positions[indices[i]]);
+            float length = glm::length(n);
+            if (length > 0.0f)
+                axis += n / length;
+        }
+        float length = glm::length(axis);
+        meshlet.coneAxis   = length > 0.0f ? axis / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+        if (length == 0.0f)
+            return;
+
+        float minDot = 1.0f;
+        for (unsigned int i = begin; i < end; i += 3)
+        {
+            glm::vec3 n = glm::cross(positions[indices[i + 1]] - positions[indices[i]],
+                                     positions[indices[i + 2]] - positions[indices[i]]);
+            float length = glm::length(n);
+            if (length > 0.0f)
+                minDot = std::min(minDot, glm::dot(n / length, meshlet.coneAxis));
+        }
+
+        // A cone wider than a hemisphere can't face away from any viewpoint
+        if (minDot > 0.0f)
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+void Meshlets::build(std::vector<unsigned int> &indices,
+                     unsigned int indexOffset, unsigned int indexCount,
+                     const std::vector<glm::vec3> &positions,
+                     std::vector<Meshlet> &meshlets)
+{
+    meshlets.clear();
+    unsigned int vertexCount   = static_cast<unsigned int>(positions.size());
+    unsigned int triangleCount = indexCount / 3;
+    const unsigned int *source = &indices[indexOffset];
+    if (triangleCount == 0)
+        return;
+
+    // Build the vertex to triangle adjacency and the triangle normals
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int i = 0; i < indexCount; i++)
+        offsets[source[i] + 1]++;
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adjacency(indexCount);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int i = 0; i < indexCount; i++)
+        adjacency[fill[source[i]]++] = i / 3;
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 n = glm::cross(positions[source[3 * t + 1]] - positions[source[3 * t]],
+                                 positions[source[3 * t + 2]] - positions[source[3 * t]]);
+        float length = glm::length(n);
+        normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+    }
+
+    // Grow each meshlet from the first triangle left in the current order,
+    // adding the neighbouring triangle that brings in the fewest new
+    // vertices and bends the normal cone least
+    std::vector<unsigned int> result;
+    result.reserve(indexCount);
+    std::vector<unsigned int> used(vertexCount, ~0u);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> candidates, triangles;
+    unsigned int seed = 0;
+    while (true)
+    {
+        while (seed < triangleCount && emitted[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        unsigned int id = static_cast<unsigned int>(meshlets.size());
+        unsigned int meshletVertices = 0;
+        glm::vec3 axis(0.0f);
+        triangles.clear();
+        candidates.assign(1, seed);
+        while (triangles.size() < maxTriangles)
+        {
+            // Pick the best candidate, dropping those that were emitted or
+            // won't fit
+            glm::vec3 direction = glm::length(axis) > 0.0f ? glm::normalize(axis) : glm::vec3(0.0f);
+            float bestScore = 1e30f;
+            int best = -1;
+            for (size_t c = 0; c < candidates.size(); )
+            {
+                unsigned int t = candidates[c];
+                unsigned int newVertices = 0;
+                for (unsigned int k = 0; k < 3; k++)
+                    newVertices += used[source[3 * t + k]] != id;
+                if (emitted[t] || meshletVertices + newVertices > maxVertices)
+                {
+                    candidates[c] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                float score = newVertices + coneWeight * (1.0f - glm::dot(normals[t], direction));
+                if (score < bestScore)
+                {
+                    bestScore = score;
+                    best = static_cast<int>(c);
+                }
+                c++;
+            }
+            if (best < 0)
+                break;
+
+            // Add it and queue its neighbours
+            unsigned int t = candidates[best];
+            candidates[best] = candidates.back();
+            candidates.pop_back();
+            emitted[t] = 1;
+            triangles.push_back(t);
+            axis += normals[t];
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = source[3 * t + k];
+                if (used[v] == id)
+                    continue;
+                used[v] = id;
+                meshletVertices++;
+                for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+                    if (!emitted[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+            }
+        }
+
+        // Keep the triangles of the meshlet in the order they were in
+        std::sort(triangles.begin(), triangles.end());
+        Meshlet meshlet = {};
+        meshlet.indexOffset = indexOffset + static_cast<unsigned int>(result.size());
+        meshlet.indexCount  = 3 * static_cast<unsigned int>(triangles.size());
+        for (size_t i = 0; i < triangles.size(); i++)
+            for (unsigned int k = 0; k < 3; k++)
+                result.push_back(source[3 * triangles[i] + k]);
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin() + indexOffset);
+    for (size_t m = 0; m < meshlets.size(); m++)
+        computeBounds(meshlets[m], indices, positions);
+}
+
+void Meshlets::cull(const std::vector<Meshlet> &meshlets,
+                    const glm::mat4 &MV, const glm::mat4 &projection,
+                    std::vector<unsigned int> &offsets, std::vector<unsigned int> &counts,
+                    MeshletStats &stats)
+{
+    offsets.clear();
+    counts.clear();
+    stats.meshlets      = static_cast<unsigned int>(meshlets.size());
+    stats.frustumCulled = 0;
+    stats.coneCulled    = 0;
+
+    // Frustum planes in view space from the rows of the projection matrix
+    // (Gribb & Hartmann), with the normals pointing inwards
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(projection[0][i], projection[1][i], projection[2][i], projection[3][i]);
+    glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0],
+                            rows[3] + rows[1], rows[3] - rows[1],
+                            rows[3] + rows[2], rows[3] - rows[2] };
+    for (int p = 0; p < 6; p++)
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+
+    float scale = std::max(glm::length(glm::vec3(MV[0])),
+                           std::max(glm::length(glm::vec3(MV[1])), glm::length(glm::vec3(MV[2]))));
+    glm::mat3 rotation(MV);
+
+    for (size_t m = 0; m < meshlets.size(); m++)
+    {
+        const Meshlet &meshlet = meshlets[m];
+        glm::vec3 centre = glm::vec3(MV * glm::vec4(meshlet.centre, 1.0f));
+        float radius = meshlet.radius * scale;
+
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++)
+            outside = glm::dot(glm::vec3(planes[p]), centre) + planes[p].w < -radius;
+        if (outside)
+        {
+            stats.frustumCulled++;
+            continue;
+        }
+
+        // The camera is at the origin, so the meshlet faces away if the
+        // direction to it lies inside the cone widened by the sphere
+        glm::vec3 axis = glm::normalize(rotation * meshlet.coneAxis);
+        if (glm::dot(centre, axis) >= meshlet.coneCutoff * glm::length(centre) + radius)
+        {
+            stats.coneCulled++;
+            continue;
+        }
+
+        if (!offsets.empty() && offsets.back() + counts.back() == meshlet.indexOffset)
+            counts.back() += meshlet.indexCount;
+        else
+        {
+            offsets.push_back(meshlet.indexOffset);
+            counts.push_back(meshlet.indexCount);
+        }
+    }
+    stats.draws = static_cast<unsigned int>(offsets.size());
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// A cluster of neighbouring triangles, stored as a range of the index buffer,
+// with the bounds used to cull it
+struct Meshlet
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    glm::vec3    centre;        // bounding sphere
+    float        radius;
+    glm::vec3    coneAxis;      // average triangle normal
+    float        coneCutoff;    // sine of the angle of the normal cone (1 if it can't be culled)
+};
+
+// Results of culling meshlets
+struct MeshletStats
+{
+    unsigned int meshlets;
+    unsigned int frustumCulled;
+    unsigned int coneCulled;
+    unsigned int draws;         // ranges left after merging neighbouring visible meshlets
+};
+
+// Partitioning of triangle lists into meshlets and culling of them on the CPU
+class Meshlets
+{
+public:
+    // Meshlet size limits
+    static const unsigned int maxVertices  = 64;
+    static const unsigned int maxTriangles = 124;
+
+    // Split a range of an index buffer into meshlets of neighbouring
+    // triangles with similar normals, reordering the range so each meshlet
+    // is contiguous. Meshlets start in the order the triangles were in and
+    // keep that order inside them, so most of the cache and overdraw order
+    // survives.
+    static void build(std::vector<unsigned int> &indices,
+                      unsigned int indexOffset, unsigned int indexCount,
+                      const std::vector<glm::vec3> &positions,
+                      std::vector<Meshlet> &meshlets);
+
+    // Cull meshlets outside the view frustum or facing away from the camera,
+    // writing the index ranges of the rest with neighbouring ranges merged
+    static void cull(const std::vector<Meshlet> &meshlets,
+                     const glm::mat4 &MV, const glm::mat4 &projection,
+                     std::vector<unsigned int> &offsets, std::vector<unsigned int> &counts,
+                     MeshletStats &stats);
+};
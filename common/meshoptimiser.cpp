@@ -0,0 +1,276 @@
+#include <algorithm>
+
+#include <common/meshoptimiser.hpp>
+
+void MeshOptimiser::optimiseVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                        std::vector<unsigned int> &clusters)
+{
+    clusters.clear();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Build the vertex to triangle adjacency
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        liveTriangles[indices[i]]++;
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    // Tipsify
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnds, candidates, result;
+    result.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    long long fan = indices[0];
+    bool newCluster = true;
+    while (fan >= 0)
+    {
+        // Emit all live triangles around the fanning vertex
+        candidates.clear();
+        unsigned int f = static_cast<unsigned int>(fan);
+        for (unsigned int a = offsets[f]; a < offsets[f + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+
+            if (newCluster)
+            {
+                clusters.push_back(static_cast<unsigned int>(result.size() / 3));
+                newCluster = false;
+            }
+
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[3 * t + k];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - timestamps[v] > cacheSize)
+                    timestamps[v] = time++;
+            }
+            emitted[t] = 1;
+        }
+
+        // Pick the candidate that will still be in the cache after its
+        // remaining triangles are emitted and that has been there longest
+        fan = -1;
+        long long best = -1;
+        for (size_t c = 0; c < candidates.size(); c++)
+        {
+            unsigned int v = candidates[c];
+            if (liveTriangles[v] == 0)
+                continue;
+
+            long long priority = 0;
+            if (time - timestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = time - timestamps[v];
+            if (priority > best)
+            {
+                best = priority;
+                fan  = v;
+            }
+        }
+
+        // Dead end: fall back to recently used vertices, then to any vertex
+        // with triangles left, starting a new cluster
+        if (fan < 0)
+        {
+            newCluster = true;
+            while (!deadEnds.empty() && fan < 0)
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                    fan = v;
+            }
+            while (fan < 0 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    fan = cursor;
+                cursor++;
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+void MeshOptimiser::optimiseOverdraw(std::vector<unsigned int> &indices,
+                                     const std::vector<glm::vec3> &positions,
+                                     const std::vector<unsigned int> &hardClusters,
+                                     float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || hardClusters.empty())
+        return;
+
+    unsigned int vertexCount = static_cast<unsigned int>(positions.size());
+
+    // Split each cluster at the first points where the cache misses so far
+    // are within the threshold of the cluster as a whole. Each simulation
+    // starts with a cold cache by moving time on past the cache size.
+    std::vector<unsigned int> clusters;
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    for (size_t c = 0; c < hardClusters.size(); c++)
+    {
+        unsigned int start = hardClusters[c];
+        unsigned int end   = c + 1 < hardClusters.size() ? hardClusters[c + 1]
+                                                         : static_cast<unsigned int>(triangleCount);
+
+        unsigned int clusterMisses = 0;
+        time += cacheSize + 1;
+        for (unsigned int i = 3 * start; i < 3 * end; i++)
+        {
+            if (time - timestamps[indices[i]] > cacheSize)
+            {
+                timestamps[indices[i]] = time++;
+                clusterMisses++;
+            }
+        }
+        float clusterAcmr = float(clusterMisses) / (end - start);
+
+        clusters.push_back(start);
+        unsigned int misses = 0, subStart = start;
+        time += cacheSize + 1;
+        for (unsigned int t = start; t < end; t++)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[3 * t + k];
+                if (time - timestamps[v] > cacheSize)
+                {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+
+            unsigned int count = t + 1 - subStart;
+            if (t + 1 < end && count >= 8 && float(misses) / count <= clusterAcmr * threshold)
+            {
+                clusters.push_back(t + 1);
+                subStart = t + 1;
+                misses   = 0;
+                time    += cacheSize + 1;
+            }
+        }
+    }
+
+    // Find the centroid of the mesh
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &p0 = positions[indices[3 * t]];
+        const glm::vec3 &p1 = positions[indices[3 * t + 1]];
+        const glm::vec3 &p2 = positions[indices[3 * t + 2]];
+        float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+        meshCentroid += area * (p0 + p1 + p2) / 3.0f;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Sort key of each cluster is how far its area weighted centroid lies
+    // in front of the mesh centroid along its average normal
+    std::vector<std::pair<float, unsigned int> > order(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        unsigned int start = clusters[c];
+        unsigned int end   = c + 1 < clusters.size() ? clusters[c + 1]
+                                                     : static_cast<unsigned int>(triangleCount);
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = start; t < end; t++)
+        {
+            const glm::vec3 &p0 = positions[indices[3 * t]];
+            const glm::vec3 &p1 = positions[indices[3 * t + 1]];
+            const glm::vec3 &p2 = positions[indices[3 * t + 2]];
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            centroid += a * (p0 + p1 + p2) / 3.0f;
+            normal   += n;
+            area     += a;
+        }
+        if (area > 0.0f)
+            centroid /= area;
+        float length = glm::length(normal);
+        if (length > 0.0f)
+            normal /= length;
+
+        order[c] = std::make_pair(-glm::dot(centroid - meshCentroid, normal), static_cast<unsigned int>(c));
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    // Emit the clusters in sorted order
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        unsigned int c     = order[i].second;
+        unsigned int start = clusters[c];
+        unsigned int end   = c + 1 < clusters.size() ? clusters[c + 1]
+                                                     : static_cast<unsigned int>(triangleCount);
+        result.insert(result.end(), indices.begin() + 3 * start, indices.begin() + 3 * end);
+    }
+    indices.swap(result);
+}
+
+unsigned int MeshOptimiser::optimiseVertexFetch(std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                                std::vector<unsigned int> &remap)
+{
+    remap.assign(vertexCount, ~0u);
+    unsigned int next = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int &index = remap[indices[i]];
+        if (index == ~0u)
+            index = next++;
+        indices[i] = index;
+    }
+    return next;
+}
+
+float MeshOptimiser::acmr(const std::vector<unsigned int> &indices, unsigned int vertexCount)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    return float(cacheMisses(indices.data(), indices.size(), vertexCount)) / (indices.size() / 3);
+}
+
+float MeshOptimiser::atvr(const std::vector<unsigned int> &indices, unsigned int vertexCount)
+{
+    if (vertexCount == 0)
+        return 0.0f;
+    return float(cacheMisses(indices.data(), indices.size(), vertexCount)) / vertexCount;
+}
+
+unsigned int MeshOptimiser::cacheMisses(const unsigned int *indices, size_t indexCount,
+                                        unsigned int vertexCount)
+{
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1, misses = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int v = indices[i];
+        if (time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Load time optimisations of indexed triangle lists
+class MeshOptimiser
+{
+public:
+    // Size of the simulated post-transform cache
+    static const unsigned int cacheSize = 16;
+
+    // Reorder triangles for post-transform cache locality using Tipsify
+    // (Sander, Nehab & Barczak 2007). The start of each cluster of triangles
+    // that can be reordered without hurting the cache is written to clusters.
+    static void optimiseVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                    std::vector<unsigned int> &clusters);
+
+    // Reorder the clusters from optimiseVertexCache so that outward facing
+    // clusters are drawn first, splitting clusters where the cache efficiency
+    // stays within threshold of the whole cluster's
+    static void optimiseOverdraw(std::vector<unsigned int> &indices,
+                                 const std::vector<glm::vec3> &positions,
+                                 const std::vector<unsigned int> &clusters,
+                                 float threshold = 1.05f);
+
+    // Build a remap table that numbers vertices in order of first use,
+    // returning the number of vertices that are used
+    static unsigned int optimiseVertexFetch(std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                            std::vector<unsigned int> &remap);
+
+    // Apply a remap table from optimiseVertexFetch to a vertex attribute
+    template <typename T>
+    static void remapVertices(std::vector<T> &attribute, const std::vector<unsigned int> &remap,
+                              unsigned int newVertexCount)
+    {
+        std::vector<T> result(newVertexCount);
+        for (unsigned int i = 0; i < remap.size(); i++)
+            if (remap[i] != ~0u)
+                result[remap[i]] = attribute[i];
+        attribute.swap(result);
+    }
+
+    // Average cache miss ratio (transformed vertices per triangle) and average
+    // transform to vertex ratio of a FIFO cache of cacheSize entries
+    static float acmr(const std::vector<unsigned int> &indices, unsigned int vertexCount);
+    static float atvr(const std::vector<unsigned int> &indices, unsigned int vertexCount);
+
+private:
+    static unsigned int cacheMisses(const unsigned int *indices, size_t indexCount,
+                                    unsigned int vertexCount);
+};
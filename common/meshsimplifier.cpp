@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <common/meshsimplifier.hpp>
+
+namespace
+{
+    // Weighted sum of squared distances to a set of planes, stored as the
+    // symmetric matrix A, vector b and constant c of p.A.p + 2 b.p + c
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    // One vertex collapsing onto a neighbour
+    struct Collapse
+    {
+        float cost;
+        unsigned int from;
+        unsigned int to;
+        unsigned int seamFrom;    // copy of from on the other side of a seam, or ~0u
+        unsigned int seamTo;
+
+        bool operator<(const Collapse &other) const { return cost < other.cost; }
+    };
+
+    // Add the plane n.p + d = 0
+    void addPlane(Quadric &q, const glm::vec3 &n, float d, float weight)
+    {
+        q.a00 += weight * n.x * n.x;
+        q.a01 += weight * n.x * n.y;
+        q.a02 += weight * n.x * n.z;
+        q.a11 += weight * n.y * n.y;
+        q.a12 += weight * n.y * n.z;
+        q.a22 += weight * n.z * n.z;
+        q.b0  += weight * n.x * d;
+        q.b1  += weight * n.y * d;
+        q.b2  += weight * n.z * d;
+        q.c   += weight * d * d;
+        q.weight += weight;
+    }
+
+    void addQuadric(Quadric &q, const Quadric &r)
+    {
+        q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+        q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+        q.b0  += r.b0;  q.b1  += r.b1;  q.b2  += r.b2;
+        q.c   += r.c;
+        q.weight += r.weight;
+    }
+
+    // Mean squared distance from a point to the planes of two quadrics
+    float evaluate(const Quadric &q, const Quadric &r, const glm::vec3 &p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = (q.a00 + r.a00) * x * x + (q.a11 + r.a11) * y * y + (q.a22 + r.a22) * z * z
+                 + 2.0 * ((q.a01 + r.a01) * x * y + (q.a02 + r.a02) * x * z + (q.a12 + r.a12) * y * z)
+                 + 2.0 * ((q.b0 + r.b0) * x + (q.b1 + r.b1) * y + (q.b2 + r.b2) * z)
+                 + q.c + r.c;
+        double weight = q.weight + r.weight;
+        return weight > 0.0 ? static_cast<float>(std::max(e, 0.0) / weight) : 0.0f;
+    }
+
+    // Weight of the planes that keep seams in place, relative to triangle area
+    const float seamWeight = 10.0f;
+
+    uint64_t edgeKey(uint64_t a, uint64_t b)
+    {
+        return a < b ? a << 32 | b : b << 32 | a;
+    }
+
+    // Number of triangles using an edge, given the sorted keys of all edges
+    size_t edgeCount(const std::vector<uint64_t> &edges, unsigned int a, unsigned int b)
+    {
+        std::pair<std::vector<uint64_t>::const_iterator, std::vector<uint64_t>::const_iterator> range =
+            std::equal_range(edges.begin(), edges.end(), edgeKey(a, b));
+        return range.second - range.first;
+    }
+
+    bool lessPosition(const glm::vec3 &a, const glm::vec3 &b)
+    {
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.y != b.y)
+            return a.y < b.y;
+        return a.z < b.z;
+    }
+}
+
+float MeshSimplifier::simplify(const std::vector<unsigned int> &indices,
+                               const std::vector<glm::vec3> &positions,
+                               size_t targetIndexCount,
+                               std::vector<unsigned int> &result)
+{
+    result = indices;
+    if (result.size() <= targetIndexCount)
+        return 0.0f;
+
+    // Give the vertices at each position the same id
+    unsigned int vertexCount = static_cast<unsigned int>(positions.size());
+    std::vector<unsigned int> order(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        order[v] = v;
+    std::sort(order.begin(), order.end(), [&positions](unsigned int a, unsigned int b)
+    {
+        return lessPosition(positions[a], positions[b]);
+    });
+
+    std::vector<unsigned int> positionId(vertexCount);
+    std::vector<unsigned int> positionStart;
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        if (i == 0 || positions[order[i]] != positions[order[i - 1]])
+            positionStart.push_back(i);
+        positionId[order[i]] = static_cast<unsigned int>(positionStart.size() - 1);
+    }
+    unsigned int positionCount = static_cast<unsigned int>(positionStart.size());
+    positionStart.push_back(vertexCount);
+
+    // Find the edges of the triangles, both between positions and between
+    // vertices. An edge between vertices that isn't shared where the edge
+    // between their positions is lies on a seam.
+    std::vector<uint64_t> edges, vertexEdges;
+    edges.reserve(indices.size());
+    vertexEdges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int a = indices[i];
+        unsigned int b = indices[i - i % 3 + (i + 1) % 3];
+        edges.push_back(edgeKey(positionId[a], positionId[b]));
+        vertexEdges.push_back(edgeKey(a, b));
+    }
+    std::sort(edges.begin(), edges.end());
+    std::sort(vertexEdges.begin(), vertexEdges.end());
+
+    // Lock the positions of open and non-manifold edges
+    std::vector<char> lockedPosition(positionCount, 0);
+    for (size_t i = 0; i < edges.size(); )
+    {
+        size_t run = i;
+        while (run < edges.size() && edges[run] == edges[i])
+            run++;
+        if (run - i != 2)
+        {
+            lockedPosition[edges[i] >> 32]        = 1;
+            lockedPosition[edges[i] & 0xffffffff] = 1;
+        }
+        i = run;
+    }
+
+    // Lock vertices where more than two vertices share a position, which is
+    // where seams meet or end
+    std::vector<char> locked(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        unsigned int id = positionId[v];
+        locked[v] = lockedPosition[id] || positionStart[id + 1] - positionStart[id] > 2;
+    }
+
+    // Quadric of the planes of the triangles around each position, weighted
+    // by their area, plus planes through seam edges at right angles to the
+    // surface to keep the seams where they are
+    Quadric zero = {};
+    std::vector<Quadric> quadrics(positionCount, zero);
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        const glm::vec3 &p0 = positions[indices[3 * t]];
+        const glm::vec3 &p1 = positions[indices[3 * t + 1]];
+        const glm::vec3 &p2 = positions[indices[3 * t + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area == 0.0f)
+            continue;
+        n /= area;
+        for (unsigned int k = 0; k < 3; k++)
+            addPlane(quadrics[positionId[indices[3 * t + k]]], n, -glm::dot(n, p0), area);
+
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            unsigned int a = indices[3 * t + k], b = indices[3 * t + (k + 1) % 3];
+            if (edgeCount(vertexEdges, a, b) != 1 || edgeCount(edges, positionId[a], positionId[b]) != 2)
+                continue;
+
+            glm::vec3 edge = positions[b] - positions[a];
+            float length = glm::length(edge);
+            if (length == 0.0f)
+                continue;
+            glm::vec3 m = glm::normalize(glm::cross(edge, n));
+            addPlane(quadrics[positionId[a]], m, -glm::dot(m, positions[a]), seamWeight * length * length);
+            addPlane(quadrics[positionId[b]], m, -glm::dot(m, positions[a]), seamWeight * length * length);
+        }
+    }
+
+    // Collapse edges in passes, in order of cost, until the target is reached
+    std::vector<unsigned int> offsets(vertexCount + 1), adjacency, remap(vertexCount);
+    std::vector<char> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    float maxError = 0.0f;
+
+    // Whether moving from onto to flips or squashes a triangle that stays
+    auto flips = [&](unsigned int from, unsigned int to)
+    {
+        for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++)
+        {
+            const unsigned int *corners = &result[3 * adjacency[a]];
+            if (positionId[corners[0]] == positionId[to] || positionId[corners[1]] == positionId[to] ||
+                positionId[corners[2]] == positionId[to])
+                continue;
+
+            glm::vec3 p[3], q[3];
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                p[k] = positions[corners[k]];
+                q[k] = positions[corners[k] == from ? to : corners[k]];
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after  = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.0f)
+                return true;
+        }
+        return false;
+    };
+
+    // Mark the triangles around a collapse as touched for the rest of the
+    // pass, returning how many of them the collapse removes
+    auto touch = [&](unsigned int from, unsigned int to)
+    {
+        size_t removed = 0;
+        for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++)
+        {
+            const unsigned int *corners = &result[3 * adjacency[a]];
+            bool removes = false;
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                touched[corners[k]] = 1;
+                removes = removes || positionId[corners[k]] == positionId[to];
+            }
+            removed += removes;
+        }
+        return removed;
+    };
+
+    while (result.size() > targetIndexCount)
+    {
+        // Build the vertex to triangle adjacency and the current vertex edges
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (size_t i = 0; i < result.size(); i++)
+            offsets[result[i] + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+
+        vertexEdges.clear();
+        for (size_t i = 0; i < result.size(); i++)
+            vertexEdges.push_back(edgeKey(result[i], result[i - i % 3 + (i + 1) % 3]));
+        std::sort(vertexEdges.begin(), vertexEdges.end());
+
+        // Cost of collapsing each edge in each direction. A vertex on a seam
+        // can only move along the seam, together with its copy on the other
+        // side of it.
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            unsigned int ends[2] = { result[i], result[i - i % 3 + (i + 1) % 3] };
+            for (unsigned int k = 0; k < 2; k++)
+            {
+                unsigned int from = ends[k], to = ends[1 - k];
+                if (locked[from])
+                    continue;
+
+                Collapse collapse = { 0.0f, from, to, ~0u, ~0u };
+                unsigned int id = positionId[from];
+                if (positionStart[id + 1] - positionStart[id] == 2)
+                {
+                    if (edgeCount(vertexEdges, from, to) != 1)
+                        continue;
+                    unsigned int copy = order[positionStart[id]] == from ? order[positionStart[id] + 1]
+                                                                         : order[positionStart[id]];
+                    unsigned int target = positionId[to];
+                    for (unsigned int j = positionStart[target]; j < positionStart[target + 1]; j++)
+                        if (edgeCount(vertexEdges, copy, order[j]) == 1)
+                        {
+                            collapse.seamFrom = copy;
+                            collapse.seamTo   = order[j];
+                        }
+                    if (collapse.seamFrom == ~0u)
+                        continue;
+                }
+                collapse.cost = evaluate(quadrics[id], quadrics[positionId[to]], positions[to]);
+                collapses.push_back(collapse);
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end());
+
+        // Take the cheapest third of the collapses that don't touch each
+        // other's triangles, so the order stays close to a one at a time
+        // greedy collapse
+        float costLimit = collapses[collapses.size() / 3].cost;
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0, collapsed = 0;
+        std::fill(touched.begin(), touched.end(), 0);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+
+        for (size_t c = 0; c < collapses.size() && removed < trianglesToRemove; c++)
+        {
+            const Collapse &collapse = collapses[c];
+            bool seam = collapse.seamFrom != ~0u;
+            if (collapsed > 0 && collapse.cost > costLimit)
+                break;
+            if (touched[collapse.from] || touched[collapse.to] ||
+                (seam && (touched[collapse.seamFrom] || touched[collapse.seamTo])))
+                continue;
+            if (flips(collapse.from, collapse.to) || (seam && flips(collapse.seamFrom, collapse.seamTo)))
+                continue;
+
+            // Apply the collapse
+            removed += touch(collapse.from, collapse.to);
+            remap[collapse.from] = collapse.to;
+            if (seam)
+            {
+                removed += touch(collapse.seamFrom, collapse.seamTo);
+                remap[collapse.seamFrom] = collapse.seamTo;
+            }
+            addQuadric(quadrics[positionId[collapse.to]], quadrics[positionId[collapse.from]]);
+            maxError = std::max(maxError, collapse.cost);
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        // Rewrite the triangles, dropping those that collapsed
+        size_t write = 0;
+        for (size_t t = 0; t < result.size() / 3; t++)
+        {
+            unsigned int a = remap[result[3 * t]];
+            unsigned int b = remap[result[3 * t + 1]];
+            unsigned int c = remap[result[3 * t + 2]];
+            if (positionId[a] == positionId[b] || positionId[b] == positionId[c] ||
+                positionId[c] == positionId[a])
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return std::sqrt(maxError);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Load time simplification of indexed triangle lists for levels of detail
+class MeshSimplifier
+{
+public:
+    // Simplify a mesh towards targetIndexCount indices by quadric error edge
+    // collapse (Garland & Heckbert 1997). Vertices are only ever collapsed
+    // onto other vertices, so the result indexes the same vertex buffer.
+    // Vertices on open borders and on uv or normal seams (positions shared by
+    // more than one vertex) are never moved. Returns the error of the result
+    // as the RMS distance to the original surface around the collapsed
+    // vertices, in model units.
+    static float simplify(const std::vector<unsigned int> &indices,
+                          const std::vector<glm::vec3> &positions,
+                          size_t targetIndexCount,
+                          std::vector<unsigned int> &result);
+};
@@ -0,0 +1,326 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <common/mipmaps.hpp>
+#include <common/threadpool.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#define MIPMAP_SSE
+#endif
+
+namespace
+{
+    // Pixels are filtered in 14-bit fixed point, so the sum of four still
+    // fits in 16 bits. Linear values are scaled by 64 and sRGB colours are
+    // converted to linear light through tables.
+    const int fixedMax = 16383;
+    const int linearShift = 6;
+
+    // Rows of output handed to a thread at once
+    const int bandRows = 16;
+
+    // Conversions of sRGB colours to and from 14-bit linear light
+    struct SrgbTables
+    {
+        uint16_t toLinear[256];
+        unsigned char fromLinear[fixedMax + 1];
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float value = i / 255.0f;
+                float linear = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+                toLinear[i] = static_cast<uint16_t>(std::floor(linear * fixedMax + 0.5f));
+            }
+            for (int i = 0; i <= fixedMax; i++)
+            {
+                float value = float(i) / fixedMax;
+                float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                fromLinear[i] = static_cast<unsigned char>(std::floor(srgb * 255.0f + 0.5f));
+            }
+        }
+    };
+
+    const SrgbTables &srgbTables()
+    {
+        static SrgbTables tables;
+        return tables;
+    }
+
+    // Whether a channel holds colour (the others being alpha, or unused)
+    bool isColour(int channel, int components)
+    {
+        return components <= 2 ? channel == 0 : channel < 3;
+    }
+
+    // Convert one pixel to fixed point, four channels to a pixel
+    template <int components>
+    inline void loadPixel(const unsigned char *pixel, bool srgb, uint16_t *out)
+    {
+        const SrgbTables &tables = srgbTables();
+        for (int c = 0; c < 4; c++)
+        {
+            if (c >= components)
+                out[c] = 0;
+            else if (srgb && isColour(c, components))
+                out[c] = tables.toLinear[pixel[c]];
+            else
+                out[c] = static_cast<uint16_t>(pixel[c] << linearShift);
+        }
+    }
+
+    // Convert the pixels of a row that a level 'columns' wide filters to
+    // fixed point
+    template <int components>
+    void loadRow(const unsigned char *row, int width, int columns, bool srgb, uint16_t *out)
+    {
+        int x = 0, end = std::min(2 * columns, width);
+#ifdef MIPMAP_SSE
+        // Four linear RGBA pixels at a time
+        if (components == 4 && !srgb)
+        {
+            __m128i zero = _mm_setzero_si128();
+            for (; x + 4 <= end; x += 4)
+            {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 4 * x));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x),
+                                 _mm_slli_epi16(_mm_unpacklo_epi8(pixels, zero), linearShift));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x + 8),
+                                 _mm_slli_epi16(_mm_unpackhi_epi8(pixels, zero), linearShift));
+            }
+        }
+#endif
+        for (; x < end; x++)
+            loadPixel<components>(row + size_t(x) * components, srgb, out + 4 * x);
+
+        // A row one pixel wide is filtered with itself
+        for (; x < 2 * columns; x++)
+            loadPixel<components>(row + size_t(width - 1) * components, srgb, out + 4 * x);
+    }
+
+    // Average each 2x2 square of two fixed point rows
+    void filterRows(const uint16_t *top, const uint16_t *bottom, int columns, uint16_t *out)
+    {
+        int x = 0;
+#ifdef MIPMAP_SSE
+        // Two output pixels at a time, from four pixels of each row
+        __m128i rounding = _mm_set1_epi16(2);
+        for (; x + 2 <= columns; x += 2)
+        {
+            __m128i left  = _mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top + 8 * x)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + 8 * x)));
+            __m128i right = _mm_add_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top + 8 * x + 8)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + 8 * x + 8)));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x),
+                             _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2));
+        }
+#endif
+        for (; x < columns; x++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = top[8 * x + c] + top[8 * x + 4 + c] + bottom[8 * x + c] + bottom[8 * x + 4 + c];
+                out[4 * x + c] = static_cast<uint16_t>((sum + 2) >> 2);
+            }
+        }
+    }
+
+    // Scale the xyz of filtered normals, which average to less than unit
+    // length, back to unit length (zero length normals are left alone)
+    void renormalise(uint16_t *row, int columns)
+    {
+        const float toNormal = 1.0f / (127.5f * (1 << linearShift)), toFixed = 127.5f * (1 << linearShift);
+        int x = 0;
+#ifdef MIPMAP_SSE
+        // Four pixels at a time, transposed so each register holds one axis
+        __m128i zero = _mm_setzero_si128();
+        __m128 scale = _mm_set1_ps(toNormal), unscale = _mm_set1_ps(toFixed), one = _mm_set1_ps(1.0f);
+        for (; x + 4 <= columns; x += 4)
+        {
+            __m128i first  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 4 * x));
+            __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 4 * x + 8));
+            __m128 p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(first, zero));
+            __m128 p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(first, zero));
+            __m128 p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(second, zero));
+            __m128 p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(second, zero));
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+            __m128 nx = _mm_sub_ps(_mm_mul_ps(p0, scale), one);
+            __m128 ny = _mm_sub_ps(_mm_mul_ps(p1, scale), one);
+            __m128 nz = _mm_sub_ps(_mm_mul_ps(p2, scale), one);
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+            __m128 valid = _mm_cmpgt_ps(lengthSquared, _mm_setzero_ps());
+            __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_or_ps(_mm_and_ps(valid, lengthSquared),
+                                                                   _mm_andnot_ps(valid, one))));
+            p0 = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(nx, inverse), one), unscale)),
+                           _mm_andnot_ps(valid, p0));
+            p1 = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ny, inverse), one), unscale)),
+                           _mm_andnot_ps(valid, p1));
+            p2 = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(nz, inverse), one), unscale)),
+                           _mm_andnot_ps(valid, p2));
+
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(row + 4 * x),
+                             _mm_packs_epi32(_mm_cvtps_epi32(p0), _mm_cvtps_epi32(p1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(row + 4 * x + 8),
+                             _mm_packs_epi32(_mm_cvtps_epi32(p2), _mm_cvtps_epi32(p3)));
+        }
+#endif
+        for (; x < columns; x++)
+        {
+            uint16_t *pixel = row + 4 * x;
+            float n[3];
+            for (int c = 0; c < 3; c++)
+                n[c] = pixel[c] * toNormal - 1.0f;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int c = 0; c < 3 && length > 0.0f; c++)
+                pixel[c] = static_cast<uint16_t>(std::floor((n[c] / length + 1.0f) * toFixed + 0.5f));
+        }
+    }
+
+    // Convert one filtered pixel back to 8 bits
+    template <int components>
+    inline void storePixel(const uint16_t *pixel, bool srgb, unsigned char *out)
+    {
+        const SrgbTables &tables = srgbTables();
+        for (int c = 0; c < components; c++)
+        {
+            if (srgb && isColour(c, components))
+                out[c] = tables.fromLinear[pixel[c]];
+            else
+                out[c] = static_cast<unsigned char>((pixel[c] + (1 << (linearShift - 1))) >> linearShift);
+        }
+    }
+
+    // Convert a filtered row back to 8 bits
+    template <int components>
+    void storeRow(const uint16_t *row, int columns, bool srgb, unsigned char *out)
+    {
+        int x = 0;
+#ifdef MIPMAP_SSE
+        // Four linear RGBA pixels at a time
+        if (components == 4 && !srgb)
+        {
+            __m128i rounding = _mm_set1_epi16(1 << (linearShift - 1));
+            for (; x + 4 <= columns; x += 4)
+            {
+                __m128i first  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 4 * x));
+                __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 4 * x + 8));
+                first  = _mm_srli_epi16(_mm_add_epi16(first, rounding), linearShift);
+                second = _mm_srli_epi16(_mm_add_epi16(second, rounding), linearShift);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x), _mm_packus_epi16(first, second));
+            }
+        }
+#endif
+        for (; x < columns; x++)
+            storePixel<components>(row + 4 * x, srgb, out + size_t(x) * components);
+    }
+
+    // Halve the rows of one band of a level
+    template <int components>
+    void downsampleBand(const unsigned char *pixels, int width, int height, MipmapFilter filter, int firstRow,
+                        int lastRow, unsigned char *out)
+    {
+        int columns = std::max(width / 2, 1);
+        bool srgb = filter == MipmapSrgb, normals = filter == MipmapNormal && components >= 3;
+        std::vector<uint16_t> top(8 * columns), bottom(8 * columns), filtered(4 * columns);
+        for (int y = firstRow; y < lastRow; y++)
+        {
+            int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            loadRow<components>(pixels + size_t(y0) * width * components, width, columns, srgb, &top[0]);
+            loadRow<components>(pixels + size_t(y1) * width * components, width, columns, srgb, &bottom[0]);
+            filterRows(&top[0], &bottom[0], columns, &filtered[0]);
+            if (normals)
+                renormalise(&filtered[0], columns);
+            storeRow<components>(&filtered[0], columns, srgb, out + size_t(y) * columns * components);
+        }
+    }
+}
+
+int Mipmaps::levelCount(int width, int height)
+{
+    int count = 0;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        count++;
+    return count;
+}
+
+int Mipmaps::levelWidth(int width, int level)
+{
+    return std::max(width >> level, 1);
+}
+
+MipmapFilter Mipmaps::filterFor(const char *name)
+{
+    // Only look at the file name, not the directories above it
+    const char *file = name;
+    for (const char *c = name; *c != 0; c++)
+    {
+        if (*c == '/' || *c == '\\')
+            file = c + 1;
+    }
+    if (strstr(file, "normal") != NULL)
+        return MipmapNormal;
+    if (strstr(file, "specular") != NULL)
+        return MipmapBox;
+    return MipmapSrgb;
+}
+
+size_t Mipmaps::levelSize(int width, int height, int components, int level)
+{
+    return size_t(levelWidth(width, level)) * levelWidth(height, level) * components;
+}
+
+size_t Mipmaps::chainSize(int width, int height, int components)
+{
+    size_t size = 0;
+    for (int level = 1; level <= levelCount(width, height); level++)
+        size += levelSize(width, height, components, level);
+    return size;
+}
+
+void Mipmaps::build(const unsigned char *pixels, int width, int height, int components, MipmapFilter filter,
+                    unsigned char *out)
+{
+    int count = levelCount(width, height);
+    for (int level = 0; level < count; level++)
+    {
+        int levelWidth = Mipmaps::levelWidth(width, level), levelHeight = Mipmaps::levelWidth(height, level);
+        downsample(pixels, levelWidth, levelHeight, components, filter, out);
+        pixels = out;
+        out += levelSize(width, height, components, level + 1);
+    }
+}
+
+void Mipmaps::downsample(const unsigned char *pixels, int width, int height, int components, MipmapFilter filter,
+                         unsigned char *out)
+{
+    int rows = std::max(height / 2, 1);
+    unsigned int bands = static_cast<unsigned int>((rows + bandRows - 1) / bandRows);
+    ThreadPool::shared().parallelFor(bands, [&](unsigned int band)
+    {
+        int firstRow = band * bandRows, lastRow = std::min(firstRow + bandRows, rows);
+        switch (components)
+        {
+        case 1:
+            downsampleBand<1>(pixels, width, height, filter, firstRow, lastRow, out);
+            break;
+        case 2:
+            downsampleBand<2>(pixels, width, height, filter, firstRow, lastRow, out);
+            break;
+        case 3:
+            downsampleBand<3>(pixels, width, height, filter, firstRow, lastRow, out);
+            break;
+        default:
+            downsampleBand<4>(pixels, width, height, filter, firstRow, lastRow, out);
+            break;
+        }
+    });
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+
+// How the smaller mip levels of a texture are made
+enum MipmapFilter
+{
+    MipmapDriver,       // glGenerateMipmap after upload, however the driver does it
+    MipmapBox,          // average of 2x2 pixels as stored (linear data such as specular maps)
+    MipmapSrgb,         // average of 2x2 sRGB colours in linear light, with alpha averaged as stored
+    MipmapNormal,       // average of 2x2 normals in xyz, renormalised
+    MipmapByName,       // one of the above picked by Mipmaps::filterFor() from the file name
+    MipmapFilterCount
+};
+
+// Building of mip chains of 8-bit images on the CPU. Levels halve in size,
+// rounding down, until they are 1x1, as OpenGL sizes them. The last row and
+// column of odd sized levels are dropped, and levels one pixel wide or high
+// repeat it. Pixels are filtered with SSE2 in 14-bit fixed point.
+class Mipmaps
+{
+public:
+    // Number of levels below a full image, and the size of one of them
+    // (level 0 is the full image)
+    static int levelCount(int width, int height);
+    static int levelWidth(int width, int level);
+
+    // Filter suiting a texture by its file name (or a Model texture type),
+    // as the assets are named: MipmapNormal for normal maps, MipmapBox for
+    // specular maps and MipmapSrgb for anything else, taken to be colour
+    static MipmapFilter filterFor(const char *name);
+
+    // Bytes of one level, and of every level below the full image
+    static size_t levelSize(int width, int height, int components, int level);
+    static size_t chainSize(int width, int height, int components);
+
+    // Build every level below the full image, one after another in out
+    // (chainSize() bytes)
+    static void build(const unsigned char *pixels, int width, int height, int components, MipmapFilter filter,
+                      unsigned char *out);
+
+    // Halve one level into the next, with bands of rows shared out over the
+    // shared thread pool
+    static void downsample(const unsigned char *pixels, int width, int height, int components,
+                           MipmapFilter filter, unsigned char *out);
+};
@@ -3,23 +3,833 @@
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <cfloat>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
 #include "model.hpp"
-#include "stb_image.hpp"
+#include "bounds.hpp"
+#include "gltf.hpp"
+#include "mappedfile.hpp"
+#include "meshcache.hpp"
+#include "meshlets.hpp"
+#include "meshoptimiser.hpp"
+#include "meshsimplifier.hpp"
+#include "tangents.hpp"
+#include "vertexformat.hpp"
+#include "threadpool.hpp"
 
-Model::Model(const char *path)
+namespace
 {
+    // Attributes and face indices read from a range of lines of an .obj file.
+    // Face indices are 0-based, except for negative (relative) .obj indices
+    // which are stored as relativeFlag | (bias + offset from the first
+    // attribute of the range) since the range may be parsed in parallel with
+    // the ones before it.
+    struct ObjData
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec2> uvs;
+        std::vector<glm::vec3> normals;
+        std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    };
+    
+    // Attribute indices of one face corner
+    struct ObjCorner
+    {
+        unsigned int v, vt, vn;
+        
+        bool operator==(const ObjCorner &other) const
+        {
+            return v == other.v && vt == other.vt && vn == other.vn;
+        }
+    };
+    
+    inline size_t hashCorner(const ObjCorner &corner)
+    {
+        unsigned long long h = corner.v * 0x9E3779B97F4A7C15ull;
+        h ^= corner.vt * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+        h ^= corner.vn * 0x165667B19E3779F9ull + (h >> 32);
+        return static_cast<size_t>(h ^ (h >> 31));
+    }
+    
+    // Fill a buffer, creating it if it hasn't been yet and writing over its
+    // storage if that is already the right size (as when a mesh is reloaded)
+    void fillBuffer(GLenum target, GLBuffer &buffer, size_t size, const void *data)
+    {
+        if (!buffer.id())
+            buffer = GLBuffer::create();
+        glBindBuffer(target, buffer.id());
+        if (size > 0 && size == buffer.size() && data != NULL)
+            glBufferSubData(target, 0, size, data);
+        else
+        {
+            buffer.setSize(size);
+            glBufferData(target, size, data, GL_STATIC_DRAW);
+        }
+    }
+    
+    // Settings of a texture of a .glb file, whose images are left with
+    // their top row first as their texture co-ordinates expect, and whose
+    // mip filter is picked by the type of texture
+    TextureSettings glbTextureSettings(const std::string &type)
+    {
+        TextureSettings settings;
+        settings.flip = false;
+        settings.mipmapFilter = Mipmaps::filterFor(type.c_str());
+        return settings;
+    }
+    
+    // Anonymous temporary file, deleted when the last reference goes
+    std::shared_ptr<FILE> temporaryFile()
+    {
+        return std::shared_ptr<FILE>(tmpfile(), [](FILE *file) { if (file != NULL) fclose(file); });
+    }
+    
+    // Temporary file in the system's temporary directory, for data that has
+    // to be mapped back in by name, deleted with the object
+    struct SpillFile
+    {
+        std::string path;
+        FILE *file;
+        
+        SpillFile() : file(NULL)
+        {
+#ifdef _WIN32
+            char *name = _tempnam(NULL, "obj");
+            if (name == NULL)
+                return;
+            path = name;
+            free(name);
+            file = fopen(path.c_str(), "w+b");
+#else
+            const char *directory = getenv("TMPDIR");
+            std::string pattern = std::string(directory != NULL && directory[0] != 0 ? directory : "/tmp") +
+                                  "/objspill.XXXXXX";
+            int descriptor = mkstemp(&pattern[0]);
+            if (descriptor < 0)
+                return;
+            path = pattern;
+            file = fdopen(descriptor, "w+b");
+            if (file == NULL)
+                close(descriptor);
+#endif
+        }
+        ~SpillFile()
+        {
+            if (file != NULL)
+                fclose(file);
+            if (!path.empty())
+                remove(path.c_str());
+        }
+    };
+    
+    // Whether a path ends with an extension, ignoring case
+    bool hasExtension(const char *path, const char *extension)
+    {
+        size_t pathLength = strlen(path), length = strlen(extension);
+        if (pathLength < length)
+            return false;
+        for (size_t i = 0; i < length; i++)
+            if (tolower(path[pathLength - length + i]) != tolower(extension[i]))
+                return false;
+        return true;
+    }
+    
+    // Components of the float formats, and 0 for the others
+    GLint floatComponents(AttributeFormat format)
+    {
+        switch (format)
+        {
+            case FormatFloat2: return 2;
+            case FormatFloat3: return 3;
+            case FormatFloat4: return 4;
+            default:           return 0;
+        }
+    }
+    
+    const unsigned int relativeFlag = 0x80000000u;
+    const long long    relativeBias = 0x40000000ll;
+    
+    // Ranges smaller than this aren't worth handing to another thread
+    const size_t minChunkSize = 512 * 1024;
+    
+    // Powers of ten that are exactly representable as doubles
+    const double powersOfTen[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    
+    inline bool isDigit(char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+    
+    inline void skipSpaces(const char *&p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+    
+    inline void skipLine(const char *&p, const char *end)
+    {
+        while (p < end && *p != '\n')
+            p++;
+        if (p < end)
+            p++;
+    }
+    
+    // Locale independent decimal float scanner ([-+]digits[.digits][e[-+]digits])
+    bool parseFloat(const char *&p, const char *end, float &value)
+    {
+        skipSpaces(p, end);
+        
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        
+        // Accumulate up to 19 significant digits, counting any we have to drop
+        unsigned long long mantissa = 0;
+        int digits = 0, exponent = 0;
+        const char *start = p;
+        for (; p < end && isDigit(*p); p++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    digits++;
+            }
+            else
+                exponent++;
+        }
+        if (p < end && *p == '.')
+        {
+            for (p++; p < end && isDigit(*p); p++)
+            {
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa != 0)
+                        digits++;
+                    exponent--;
+                }
+            }
+        }
+        if (p == start || (p == start + 1 && *start == '.'))
+            return false;
+        
+        // Optional exponent
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+            if (q < end && isDigit(*q))
+            {
+                int e = 0;
+                for (; q < end && isDigit(*q); q++)
+                    if (e < 10000)
+                        e = e * 10 + (*q - '0');
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+        
+        // Scale by an exact power of ten where possible so the common case
+        // (six decimal places) rounds the same way strtod does
+        double result = static_cast<double>(mantissa);
+        if (mantissa != 0)
+        {
+            while (exponent > 22)
+            {
+                result *= 1e22;
+                exponent -= 22;
+            }
+            while (exponent < -22)
+            {
+                result /= 1e22;
+                exponent += 22;
+            }
+            if (exponent >= 0)
+                result *= powersOfTen[exponent];
+            else
+                result /= powersOfTen[-exponent];
+        }
+        value = static_cast<float>(negative ? -result : result);
+        return true;
+    }
+    
+    bool parseInt(const char *&p, const char *end, long long &value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p == end || !isDigit(*p))
+            return false;
+        
+        long long result = 0;
+        for (; p < end && isDigit(*p); p++)
+            if (result < 0xFFFFFFFFll)
+                result = result * 10 + (*p - '0');
+        value = negative ? -result : result;
+        return true;
+    }
+    
+    // Convert a 1-based or negative relative .obj index into a range index
+    bool encodeIndex(long long index, size_t count, unsigned int &out)
+    {
+        if (index > 0 && index < relativeFlag)
+            out = static_cast<unsigned int>(index - 1);
+        else if (index < 0 && static_cast<long long>(count) + index + relativeBias >= 0)
+            out = relativeFlag | static_cast<unsigned int>(static_cast<long long>(count) + index + relativeBias);
+        else
+            return false;
+        return true;
+    }
+    
+    // Convert a range index into an index into the merged attribute arrays
+    inline bool decodeIndex(unsigned int index, size_t base, size_t count, size_t &out)
+    {
+        if (index & relativeFlag)
+        {
+            long long resolved = static_cast<long long>(base) +
+                                 static_cast<long long>(index & ~relativeFlag) - relativeBias;
+            if (resolved < 0)
+                return false;
+            out = static_cast<size_t>(resolved);
+        }
+        else
+            out = index;
+        return out < count;
+    }
+    
+    // Read one v/vt/vn face corner
+    bool parseCorner(const char *&p, const char *end, const ObjData &obj,
+                     unsigned int &vertexIndex, unsigned int &uvIndex,
+                     unsigned int &normalIndex)
+    {
+        long long v, vt, vn;
+        if (!parseInt(p, end, v) || p == end || *p++ != '/' ||
+            !parseInt(p, end, vt) || p == end || *p++ != '/' ||
+            !parseInt(p, end, vn))
+            return false;
+        
+        return encodeIndex(v, obj.vertices.size(), vertexIndex) &&
+               encodeIndex(vt, obj.uvs.size(), uvIndex) &&
+               encodeIndex(vn, obj.normals.size(), normalIndex);
+    }
+    
+    // Parse the lines in [begin, end), which must start at the beginning of a line
+    bool parseObj(const char *begin, const char *end, ObjData &obj)
+    {
+        const char *p = begin;
+        while (p < end)
+        {
+            // Read the first word of the line
+            skipSpaces(p, end);
+            if (p == end)
+                break;
+            
+            char c0 = *p;
+            char c1 = p + 1 < end ? p[1] : '\n';
+            char c2 = p + 2 < end ? p[2] : '\n';
+            
+            if (c0 == 'v' && (c1 == ' ' || c1 == '\t'))
+            {
+                // Read vertices
+                glm::vec3 vertex;
+                p += 1;
+                if (!parseFloat(p, end, vertex.x) || !parseFloat(p, end, vertex.y) ||
+                    !parseFloat(p, end, vertex.z))
+                    return false;
+                obj.vertices.push_back(vertex);
+            }
+            else if (c0 == 'v' && c1 == 't' && (c2 == ' ' || c2 == '\t'))
+            {
+                // Read texture co-ordinates
+                glm::vec2 uv;
+                p += 2;
+                if (!parseFloat(p, end, uv.x) || !parseFloat(p, end, uv.y))
+                    return false;
+                obj.uvs.push_back(uv);
+            }
+            else if (c0 == 'v' && c1 == 'n' && (c2 == ' ' || c2 == '\t'))
+            {
+                // Read vertex normals
+                glm::vec3 normal;
+                p += 2;
+                if (!parseFloat(p, end, normal.x) || !parseFloat(p, end, normal.y) ||
+                    !parseFloat(p, end, normal.z))
+                    return false;
+                obj.normals.push_back(normal);
+            }
+            else if (c0 == 'f' && (c1 == ' ' || c1 == '\t'))
+            {
+                // Read vertex indices, triangulating polygons as a fan
+                unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
+                unsigned int corners = 0;
+                p += 1;
+                while (true)
+                {
+                    skipSpaces(p, end);
+                    if (p == end || *p == '\n' || *p == '#')
+                        break;
+                    
+                    unsigned int slot = corners < 2 ? corners : 2;
+                    if (!parseCorner(p, end, obj, vertexIndex[slot], uvIndex[slot],
+                                     normalIndex[slot]))
+                        return false;
+                    
+                    if (++corners >= 3)
+                    {
+                        obj.vertexIndices.insert(obj.vertexIndices.end(), vertexIndex, vertexIndex + 3);
+                        obj.uvIndices    .insert(obj.uvIndices.end(),     uvIndex,     uvIndex + 3);
+                        obj.normalIndices.insert(obj.normalIndices.end(), normalIndex, normalIndex + 3);
+                        vertexIndex[1] = vertexIndex[2];
+                        uvIndex[1]     = uvIndex[2];
+                        normalIndex[1] = normalIndex[2];
+                    }
+                }
+                if (corners < 3)
+                    return false;
+            }
+            
+            // Skip whatever is left of the line (comments, w components, etc.)
+            skipLine(p, end);
+        }
+        
+        return true;
+    }
+}
+
+Model::Model(const char *path, const ModelOptions &options) : Model()
+{
+    load(path, options);
+    upload();
+}
+
+Model::Model()
+{
+    positionStream = false;
+    vertexCount = 0;
+    indexCount  = 0;
+    indexType   = GL_UNSIGNED_INT;
+    boundsMin   = glm::vec3(0.0f);
+    boundsMax   = glm::vec3(0.0f);
+    BoundingSphere noSphere = { glm::vec3(0.0f), 0.0f };
+    OrientedBox noBox = { glm::vec3(0.0f), glm::mat3(1.0f), glm::vec3(0.0f) };
+    boundingSphere = noSphere;
+    orientedBox    = noBox;
+    transform   = glm::mat4(1.0f);
+    directVertexSize = 0;
+    
+    lodPixelError   = 1.0f;
+    lodScreenHeight = 768.0f;
+    ModelLod empty = { 0, 0, 0.0f };
+    lods.assign(1, empty);
+    useMeshlets = false;
+    useOrientedBox = false;
+    memset(&meshletStats, 0, sizeof(meshletStats));
+    streamWindow  = 0;
+    releaseMesh   = false;
+    keepPositions = false;
+    pool          = NULL;
+    
+    ready           = false;
+    placeholder     = NULL;
+    pendingVertices = NULL;
+    pendingIndices  = NULL;
+}
+
+void Model::load(const char *path, const ModelOptions &options)
+{
+    vertexLayout    = options.vertexLayout;
+    positionStream  = options.positionStream;
+    lodLevels       = options.lodLevels;
+    lodPixelError   = options.lodPixelError;
+    lodScreenHeight = options.lodScreenHeight;
+    if (lodLevels.size() > MeshCache::maxLods - 1)
+        lodLevels.resize(MeshCache::maxLods - 1);
+    useMeshlets = options.meshlets;
+    useOrientedBox = options.orientedBox;
+    releaseMesh   = options.releaseMesh;
+    keepPositions = options.keepPositions;
+    streamWindow  = options.streamWindow;
+    pool          = options.pool;
+    if (pool != NULL && pool->layout().code() != vertexLayout.code())
+    {
+        printf("%s doesn't have the vertex layout of its pool, giving it buffers of its own\n", path);
+        pool = NULL;
+    }
+    
+    // Read the materials and node transforms of .glb files, and use their
+    // buffers as they are if they can be
+    GltfFile gltf;
+    bool glb = hasExtension(path, ".glb");
+    if (glb)
+    {
+        printf("Loading file %s\n", path);
+        if (!gltf.open(path))
+            return;
+        loadGlbScene(gltf);
+        if (mapGlb(gltf))
+            return;
+    }
+    
+    // Stream files too big to hold in memory through temporary files
+    if (streamWindow > 0 && !glb)
+    {
+        streamObj(path);
+        return;
+    }
+    
+    // Describe the options that change what is cached, which names the cache
+    // file so loads with other options don't overwrite it
+    std::string cacheSettings = "layout " + std::to_string(vertexLayout.code()) +
+                                " meshlets " + std::to_string(useMeshlets ? sizeof(Meshlet) : 0) +
+                                " box " + std::to_string(int(useOrientedBox)) + " lods";
+    for (unsigned int i = 0; i < lodLevels.size(); i++)
+        cacheSettings += " " + std::to_string(lodLevels[i]);
+    
+    // Upload straight from the binary cache if it is up to date and holds
+    // the same levels of detail, keeping it mapped until then
+    std::shared_ptr<MappedFile> cacheFile = std::make_shared<MappedFile>();
+    const MeshCacheHeader *cache = MeshCache::open(path, cacheSettings, *cacheFile);
+    bool cacheMatches = cache != NULL && cache->vertexFormat == vertexLayout.code() &&
+                        cache->lodCount == lodLevels.size() + 1;
+    for (unsigned int i = 1; cacheMatches && i < cache->lodCount; i++)
+        cacheMatches = cache->lods[i].level == lodLevels[i - 1];
+    cacheMatches = cacheMatches && (cache->meshletCount > 0) == useMeshlets &&
+                   (cache->meshletCount == 0 || cache->meshletSize == sizeof(Meshlet)) &&
+                   (cache->hasOrientedBox != 0 || !useOrientedBox);
+    if (cacheMatches)
+    {
+        printf("Loading file %s\n", MeshCache::cachePath(path, cacheSettings).c_str());
+        vertexCount = cache->vertexCount;
+        indexCount  = cache->indexCount;
+        indexType   = cache->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        boundsMin   = glm::vec3(cache->boundsMin[0], cache->boundsMin[1], cache->boundsMin[2]);
+        boundsMax   = glm::vec3(cache->boundsMax[0], cache->boundsMax[1], cache->boundsMax[2]);
+        boundingSphere.centre = glm::vec3(cache->sphere[0], cache->sphere[1], cache->sphere[2]);
+        boundingSphere.radius = cache->sphere[3];
+        if (cache->hasOrientedBox != 0)
+        {
+            orientedBox.centre      = glm::vec3(cache->boxCentre[0], cache->boxCentre[1], cache->boxCentre[2]);
+            orientedBox.halfExtents = glm::vec3(cache->boxHalfExtents[0], cache->boxHalfExtents[1], cache->boxHalfExtents[2]);
+            for (int i = 0; i < 3; i++)
+                orientedBox.axes[i] = glm::vec3(cache->boxAxes[3 * i], cache->boxAxes[3 * i + 1], cache->boxAxes[3 * i + 2]);
+        }
+        lods.resize(cache->lodCount);
+        for (unsigned int i = 0; i < cache->lodCount; i++)
+        {
+            lods[i].indexOffset = cache->lods[i].indexOffset;
+            lods[i].indexCount  = cache->lods[i].indexCount;
+            lods[i].error       = cache->lods[i].error;
+        }
+        const Meshlet *cachedMeshlets = static_cast<const Meshlet *>(MeshCache::meshletData(cache));
+        meshlets.assign(cachedMeshlets, cachedMeshlets + cache->meshletCount);
+        pendingCache    = cacheFile;
+        pendingVertices = MeshCache::vertexData(cache);
+        pendingIndices  = MeshCache::indexData(cache);
+        
+        // Decode the positions and full mesh triangles if they are wanted
+        if (keepPositions)
+        {
+            VertexEncoder::decodePositions(vertexLayout, pendingVertices, vertexCount,
+                                           boundsMin, boundsMax, vertices);
+            indices.resize(lods[0].indexCount);
+            for (unsigned int i = 0; i < lods[0].indexCount; i++)
+                indices[i] = indexType == GL_UNSIGNED_SHORT ? static_cast<const unsigned short *>(pendingIndices)[i]
+                                                            : static_cast<const unsigned int *>(pendingIndices)[i];
+        }
+        return;
+    }
+    cacheFile.reset();
+    
     // Load object
-    bool res = loadObj(path, vertices, uvs, normals);
+    if (glb ? !loadGlb(gltf, vertices, uvs, normals, indices) : !loadObj(path, vertices, uvs, normals, indices))
+        return;
+    
+    // Generate the levels of detail, then reorder the triangles and vertices
+    // for the GPU
+    buildLods();
+    optimise();
     
-    // Setup buffers
-    setupBuffers();
+    // Generate the tangents for normal mapping from the full mesh
+    if (vertexLayout.find(AttributeTangent) != NULL)
+        Tangents::generate(indices, lods[0].indexCount, vertices, uvs, normals, tangents);
+    
+    // Find the bounding volumes
+    vertexCount = static_cast<unsigned int>(vertices.size());
+    indexCount  = static_cast<unsigned int>(indices.size());
+    computeBounds(vertices.data(), vertices.size());
+    
+    // Interleave and encode the vertex attributes
+    VertexStreams streams;
+    streams.positions = &vertices;
+    streams.uvs       = &uvs;
+    streams.normals   = &normals;
+    streams.tangents  = &tangents;
+    VertexError error = VertexEncoder::encode(vertexLayout, streams, vertexCount,
+                                              boundsMin, boundsMax, pendingVertexData);
+    if (vertexLayout.code() != VertexLayout::standard().code())
+        printf("%u bytes per vertex, max error: position %g, uv %g, normal %.3f degrees\n",
+               vertexLayout.stride(), error.position, error.uv, error.normal);
+    
+    // Use 16-bit indices when they are big enough
+    pendingVertices = pendingVertexData.data();
+    pendingIndices  = indices.data();
+    if (vertexCount <= 65536)
+    {
+        pendingShortIndices.assign(indices.begin(), indices.end());
+        indexType      = GL_UNSIGNED_SHORT;
+        pendingIndices = pendingShortIndices.data();
+    }
+    
+    // Save the processed mesh so the next run can skip parsing
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.vertexCount  = vertexCount;
+    header.vertexStride = vertexLayout.stride();
+    header.vertexFormat = vertexLayout.code();
+    header.indexCount   = indexCount;
+    header.indexSize    = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    for (int i = 0; i < 3; i++)
+    {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+        header.sphere[i]    = boundingSphere.centre[i];
+        header.boxCentre[i]      = orientedBox.centre[i];
+        header.boxHalfExtents[i] = orientedBox.halfExtents[i];
+        for (int j = 0; j < 3; j++)
+            header.boxAxes[3 * i + j] = orientedBox.axes[i][j];
+    }
+    header.sphere[3]      = boundingSphere.radius;
+    header.hasOrientedBox = useOrientedBox ? 1 : 0;
+    header.lodCount = static_cast<uint32_t>(lods.size());
+    for (unsigned int i = 0; i < lods.size(); i++)
+    {
+        header.lods[i].level       = i == 0 ? 1.0f : lodLevels[i - 1];
+        header.lods[i].error       = lods[i].error;
+        header.lods[i].indexOffset = lods[i].indexOffset;
+        header.lods[i].indexCount  = lods[i].indexCount;
+    }
+    header.meshletCount = static_cast<uint32_t>(meshlets.size());
+    header.meshletSize  = sizeof(Meshlet);
+    if (!MeshCache::write(path, cacheSettings, header, pendingVertices, pendingIndices, meshlets.data()))
+        printf("Couldn't write %s\n", MeshCache::cachePath(path, cacheSettings).c_str());
+}
+
+void Model::upload()
+{
+    if (pendingVertexFile)
+    {
+        setupBuffers(NULL, NULL);
+        streamBuffers();
+    }
+    else
+        setupBuffers(pendingVertices, pendingIndices);
+    for (size_t i = 0; i < pendingTextures.size(); i++)
+    {
+        std::shared_ptr<GLTexture> texture = std::make_shared<GLTexture>(GLTexture::create());
+        TextureCache::upload(*texture, pendingTextures[i].data, glbTextureSettings(pendingTextures[i].type));
+        addTexture(TextureHandle(texture, &texture->id()), pendingTextures[i].type);
+    }
+    
+    // Free the copies of the data that is now on the GPU
+    pendingCache.reset();
+    pendingVertexFile.reset();
+    pendingIndexFile.reset();
+    std::vector<PendingTexture>().swap(pendingTextures);
+    std::vector<unsigned char>().swap(pendingVertexData);
+    std::vector<unsigned short>().swap(pendingShortIndices);
+    pendingVertices = NULL;
+    pendingIndices  = NULL;
+    ready = true;
+    
+    // Free the CPU copy of the mesh, or all of it but the positions and the
+    // full mesh triangles
+    if (releaseMesh)
+    {
+        std::vector<glm::vec2>().swap(uvs);
+        std::vector<glm::vec3>().swap(normals);
+        std::vector<glm::vec4>().swap(tangents);
+        if (keepPositions)
+        {
+            indices.resize(lods[0].indexCount);
+            std::vector<unsigned int>(indices).swap(indices);
+            std::vector<glm::vec3>(vertices).swap(vertices);
+        }
+        else
+        {
+            std::vector<unsigned int>().swap(indices);
+            std::vector<glm::vec3>().swap(vertices);
+        }
+    }
+}
+
+void Model::replaceMesh(Model &fresh)
+{
+    // Take the mesh and the data waiting for upload, keeping the material and
+    // the GL objects so that upload() refills them in place
+    vertices.swap(fresh.vertices);
+    uvs.swap(fresh.uvs);
+    normals.swap(fresh.normals);
+    tangents.swap(fresh.tangents);
+    indices.swap(fresh.indices);
+    lods.swap(fresh.lods);
+    meshlets.swap(fresh.meshlets);
+    boundsMin   = fresh.boundsMin;
+    boundsMax   = fresh.boundsMax;
+    boundingSphere = fresh.boundingSphere;
+    orientedBox    = fresh.orientedBox;
+    transform   = fresh.transform;
+    vertexCount = fresh.vertexCount;
+    indexCount  = fresh.indexCount;
+    indexType   = fresh.indexType;
+    pendingCache = fresh.pendingCache;
+    pendingVertexData.swap(fresh.pendingVertexData);
+    pendingShortIndices.swap(fresh.pendingShortIndices);
+    pendingVertices   = fresh.pendingVertices;
+    pendingIndices    = fresh.pendingIndices;
+    pendingVertexFile = fresh.pendingVertexFile;
+    pendingIndexFile  = fresh.pendingIndexFile;
+    vertexPointers.swap(fresh.vertexPointers);
+    directVertexSize = fresh.directVertexSize;
+    
+    // Textures of a .glb file replace the ones of the same type
+    for (size_t i = 0; i < fresh.pendingTextures.size(); i++)
+    {
+        for (size_t j = textures.size(); j-- > 0; )
+        {
+            if (textures[j].type == fresh.pendingTextures[i].type)
+                textures.erase(textures.begin() + j);
+        }
+    }
+    pendingTextures.swap(fresh.pendingTextures);
+    upload();
+}
+
+Bounds Model::worldBounds(const glm::mat4 &model) const
+{
+    Bounds bounds;
+    bounds.min    = boundsMin;
+    bounds.max    = boundsMax;
+    bounds.sphere = boundingSphere;
+    bounds.box    = orientedBox;
+    return BoundingVolumes::transform(bounds, model);
+}
+
+size_t Model::uploadSize() const
+{
+    unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    size_t size = size_t(indexCount) * indexSize;
+    if (!vertexPointers.empty())
+        return size + directVertexSize;
+    size += size_t(vertexCount) * vertexLayout.stride();
+    if (pool != NULL ? pool->hasPositionStream() : positionStream)
+        size += size_t(vertexCount) * VertexLayout::positionsOf(vertexLayout).stride();
+    return size;
 }
 
 void Model::draw(unsigned int &shaderID)
+{
+    if (!ready)
+    {
+        if (placeholder != NULL)
+            placeholder->draw(shaderID);
+        return;
+    }
+    drawLod(shaderID, 0);
+}
+
+void Model::draw(unsigned int &shaderID, const glm::mat4 &MV, const glm::mat4 &projection)
+{
+    if (!ready)
+    {
+        if (placeholder != NULL)
+            placeholder->draw(shaderID);
+        return;
+    }
+    
+    unsigned int lod = selectLod(MV, projection);
+    if (lod == 0 && !meshlets.empty())
+        drawMeshlets(shaderID, MV, projection);
+    else
+    {
+        memset(&meshletStats, 0, sizeof(meshletStats));
+        drawLod(shaderID, lod);
+    }
+}
+
+unsigned int Model::selectLod(const glm::mat4 &MV, const glm::mat4 &projection) const
+{
+    // Bounding sphere in view space
+    glm::vec3 centre = glm::vec3(MV * glm::vec4(boundingSphere.centre, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(MV[0])),
+                           glm::max(glm::length(glm::vec3(MV[1])), glm::length(glm::vec3(MV[2]))));
+    float radius = boundingSphere.radius * scale;
+    
+    // Use the full mesh when the camera is inside the sphere
+    float distance = -centre.z - radius;
+    if (distance <= 0.0f)
+        return 0;
+    
+    // Pick the coarsest level whose error covers at most lodPixelError pixels
+    // at the nearest point of the sphere
+    float pixelsPerUnit = 0.5f * lodScreenHeight * projection[1][1] * scale / distance;
+    for (unsigned int lod = static_cast<unsigned int>(lods.size()) - 1; lod > 0; lod--)
+        if (lods[lod].error * pixelsPerUnit <= lodPixelError)
+            return lod;
+    return 0;
+}
+
+void Model::drawLod(unsigned int &shaderID, unsigned int lod)
+{
+    bindMaterial(shaderID);
+    
+    // Draw the triangles of the level of detail
+    unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    GLObjects::bindVertexArray(vertexArray(false));
+    glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, indexType,
+                             (void*)(indexStart() + size_t(lods[lod].indexOffset) * indexSize), baseVertex());
+}
+
+void Model::drawMeshlets(unsigned int &shaderID, const glm::mat4 &MV, const glm::mat4 &projection)
+{
+    // Cull the meshlets, leaving ranges of the index buffer to draw
+    Meshlets::cull(meshlets, MV, projection, drawOffsets, drawCounts, meshletStats);
+    if (drawOffsets.empty())
+        return;
+    
+    unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    drawSizes.resize(drawCounts.size());
+    drawPointers.resize(drawOffsets.size());
+    drawBaseVertices.assign(drawOffsets.size(), baseVertex());
+    for (unsigned int i = 0; i < drawOffsets.size(); i++)
+    {
+        drawSizes[i]    = static_cast<GLsizei>(drawCounts[i]);
+        drawPointers[i] = (const void*)(indexStart() + size_t(drawOffsets[i]) * indexSize);
+    }
+    
+    // Draw them all in one call
+    bindMaterial(shaderID);
+    GLObjects::bindVertexArray(vertexArray(false));
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawSizes.data(), indexType, drawPointers.data(),
+                                  static_cast<GLsizei>(drawSizes.size()), drawBaseVertices.data());
+}
+
+void Model::bindMaterial(unsigned int &shaderID)
 {
     // Send material properties to the shader
     glUniform1f(glGetUniformLocation(shaderID, "ka"), ka);
@@ -27,6 +837,9 @@ void Model::draw(unsigned int &shaderID)
     glUniform1f(glGetUniformLocation(shaderID, "ks"), ks);
     glUniform1f(glGetUniformLocation(shaderID, "Ns"), Ns);
     
+    // Send the parameters for decoding quantised vertices to the shader
+    sendVertexDecoding(shaderID);
+    
     // Bind the textures
     unsigned int diffuseNum = 0;
     unsigned int normalNum = 0;
@@ -38,218 +851,809 @@ void Model::draw(unsigned int &shaderID)
         glUniform1i(glGetUniformLocation(shaderID, (name + "Map").c_str()), i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+}
+
+void Model::drawDepth(unsigned int &shaderID)
+{
+    if (!ready)
+    {
+        if (placeholder != NULL)
+            placeholder->drawDepth(shaderID);
+        return;
+    }
+    
+    sendVertexDecoding(shaderID);
+    GLObjects::bindVertexArray(vertexArray(true));
+    glDrawElementsBaseVertex(GL_TRIANGLES, lods[0].indexCount, indexType, (void*)indexStart(), baseVertex());
+}
+
+unsigned int Model::vertexArray(bool depth) const
+{
+    // Fall back to the full vertices if there is no position stream
+    if (poolRange)
+        return depth && pool->hasPositionStream() ? pool->depthVertexArray() : pool->vertexArray();
+    return depth && positionStream ? depthVAO.id() : VAO.id();
+}
+
+GLint Model::baseVertex() const
+{
+    return poolRange ? static_cast<GLint>(poolRange->firstVertex) : 0;
+}
+
+size_t Model::indexStart() const
+{
+    return poolRange ? poolRange->indexOffset : 0;
+}
+
+void Model::sendVertexDecoding(unsigned int shaderID)
+{
+    const VertexElement *position = vertexLayout.find(AttributePosition);
+    const VertexElement *normal   = vertexLayout.find(AttributeNormal);
+    const VertexElement *tangent  = vertexLayout.find(AttributeTangent);
+    bool quantised  = position != NULL && position->format == FormatUnorm16x3;
+    bool octahedral = normal != NULL && (normal->format == FormatOct16 || normal->format == FormatOct8);
+    bool octahedralTangents = tangent != NULL && tangent->format == FormatOctTangent16;
     
-    // Draw the triangles
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<unsigned int>(vertices.size()));
-    glBindVertexArray(0);
+    glm::vec3 positionOffset = quantised ? boundsMin : glm::vec3(0.0f);
+    glm::vec3 positionScale  = quantised ? boundsMax - boundsMin : glm::vec3(1.0f);
+    glUniform3fv(glGetUniformLocation(shaderID, "positionOffset"), 1, &positionOffset[0]);
+    glUniform3fv(glGetUniformLocation(shaderID, "positionScale"), 1, &positionScale[0]);
+    glUniform1i(glGetUniformLocation(shaderID, "octahedralNormals"), octahedral);
+    glUniform1i(glGetUniformLocation(shaderID, "octahedralTangents"), octahedralTangents);
 }
 
-void Model::setupBuffers()
+void Model::setupBuffers(const void *vertexData, const void *indexData)
 {
-    // Create and bind the Vertex Array Object (VAO)
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
     
-    // Create Vertex Buffer Object
-    unsigned int vertexBuffer;
-    glGenBuffers(1, &vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+    // Take a range of the pool instead if the mesh goes in one (a reloaded
+    // mesh gives its old range back first)
+    if (pool != NULL)
+    {
+        poolRange.reset();
+        poolRange = pool->allocate(vertexCount, size_t(indexCount) * indexSize);
+        if (vertexData != NULL)
+            pool->upload(*poolRange, vertexData, indexData);
+        return;
+    }
     
-    // Create uv buffer
-    unsigned int uvBuffer;
-    glGenBuffers(1, &uvBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+    // Create and bind the Vertex Array Object (VAO), or refill the one the
+    // model already has when it is reloaded
+    if (!VAO.id())
+        VAO = GLVertexArray::create();
+    GLObjects::bindVertexArray(VAO.id());
     
-    // Create normal buffer
-    unsigned int normalBuffer;
-    glGenBuffers(1, &normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
+    // Fill the interleaved Vertex Buffer Object (or one holding the vertex
+    // data as it was stored)
+    fillBuffer(GL_ARRAY_BUFFER, vertexBuffer,
+               vertexPointers.empty() ? size_t(vertexCount) * vertexLayout.stride() : directVertexSize, vertexData);
     
-    // Bind the vertex buffer
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    // Fill the element buffer
+    fillBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer, size_t(indexCount) * indexSize, indexData);
     
-    // Bind the uv buffer
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    // Point the attributes into the vertex buffer
+    if (vertexPointers.empty())
+        vertexLayout.apply();
+    else
+        VertexLayout::apply(vertexPointers);
     
-    // Bind the normal buffer
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    // Create a VAO that fetches only positions, from a buffer of their own,
+    // for depth and shadow passes. Vertex data used as it was stored is
+    // left where it is, fetching just the positions from it.
+    if (!positionStream)
+    {
+        positionBuffer.reset();
+        depthVAO.reset();
+    }
+    else if (!depthVAO.id())
+        depthVAO = GLVertexArray::create();
+    if (positionStream && !vertexPointers.empty())
+    {
+        positionBuffer.reset();
+        GLObjects::bindVertexArray(depthVAO.id());
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.id());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+        VertexLayout::apply(std::vector<VertexPointer>(1, vertexPointers[0]));
+    }
+    else if (positionStream)
+    {
+        VertexLayout positionLayout = VertexLayout::positionsOf(vertexLayout);
+        std::vector<unsigned char> positionData;
+        if (vertexData != NULL)
+            VertexEncoder::extract(vertexLayout, AttributePosition, vertexData, vertexCount, positionData);
+        
+        GLObjects::bindVertexArray(depthVAO.id());
+        fillBuffer(GL_ARRAY_BUFFER, positionBuffer, size_t(vertexCount) * positionLayout.stride(),
+                   vertexData != NULL ? positionData.data() : NULL);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+        positionLayout.apply();
+    }
     
-     // Unbind the VAO
-    glBindVertexArray(0);
+    // Unbind the VAO (the element buffer binding is part of the VAO state)
+    GLObjects::bindVertexArray(0);
+}
+
+void Model::streamBuffers()
+{
+    // Read a window at a time and copy it into place through the copy
+    // target, which leaves the VAO bindings alone
+    unsigned int stride = vertexLayout.stride();
+    size_t perWindow = std::max<size_t>(1, streamWindow / stride);
+    std::vector<unsigned char> data(perWindow * stride), positionData;
+    VertexLayout positionLayout = VertexLayout::positionsOf(vertexLayout);
+    
+    // Buffers to fill, and where the mesh starts in them
+    bool positions = pool != NULL ? pool->hasPositionStream() : positionStream;
+    unsigned int vertexTarget   = pool != NULL ? pool->vertexBuffer() : vertexBuffer.id();
+    unsigned int positionTarget = pool != NULL ? pool->positionBuffer() : positionBuffer.id();
+    unsigned int indexTarget    = pool != NULL ? pool->indexBuffer() : indexBuffer.id();
+    size_t firstVertex = static_cast<size_t>(baseVertex());
+    
+    rewind(pendingVertexFile.get());
+    for (size_t first = 0; first < vertexCount; )
+    {
+        size_t count = fread(data.data(), stride, perWindow, pendingVertexFile.get());
+        if (count == 0)
+            break;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexTarget);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (firstVertex + first) * stride, count * stride, data.data());
+        if (positions)
+        {
+            VertexEncoder::extract(vertexLayout, AttributePosition, data.data(),
+                                   static_cast<unsigned int>(count), positionData);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, positionTarget);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (firstVertex + first) * positionLayout.stride(),
+                            positionData.size(), positionData.data());
+        }
+        first += count;
+    }
+    
+    // Indices were spilled as 32-bit and are narrowed if 16 bits will do
+    perWindow = std::max<size_t>(1, streamWindow / sizeof(unsigned int));
+    std::vector<unsigned int> indexData(perWindow);
+    std::vector<unsigned short> shortData;
+    rewind(pendingIndexFile.get());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexTarget);
+    for (size_t first = 0; first < indexCount; )
+    {
+        size_t count = fread(indexData.data(), sizeof(unsigned int), perWindow, pendingIndexFile.get());
+        if (count == 0)
+            break;
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            shortData.assign(indexData.begin(), indexData.begin() + count);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, indexStart() + first * sizeof(unsigned short),
+                            count * sizeof(unsigned short), shortData.data());
+        }
+        else
+            glBufferSubData(GL_COPY_WRITE_BUFFER, indexStart() + first * sizeof(unsigned int),
+                            count * sizeof(unsigned int), indexData.data());
+        first += count;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
 void Model::deleteBuffers()
 {
-    glDeleteBuffers(1, &vertexBuffer);
-    glDeleteBuffers(1, &uvBuffer);
-    glDeleteBuffers(1, &normalBuffer);
-    glDeleteVertexArrays(1, &VAO);
+    // The buffers are also deleted with the model
+    vertexBuffer.reset();
+    indexBuffer.reset();
+    VAO.reset();
+    positionBuffer.reset();
+    depthVAO.reset();
+    poolRange.reset();
+    textures.clear();
+}
+
+void Model::computeBounds(const glm::vec3 *positions, size_t count)
+{
+    BoundingVolumes::box(positions, count, boundsMin, boundsMax);
+    boundingSphere = BoundingVolumes::sphere(positions, count);
+    if (useOrientedBox)
+        orientedBox = BoundingVolumes::orientedBox(positions, count);
+}
+
+void Model::buildLods()
+{
+    // Simplify each level from the full mesh, in parallel
+    unsigned int fullCount = static_cast<unsigned int>(indices.size());
+    std::vector<std::vector<unsigned int> > lodIndices(lodLevels.size());
+    std::vector<float> errors(lodLevels.size());
+    ThreadPool::shared().parallelFor(static_cast<unsigned int>(lodLevels.size()), [&](unsigned int i)
+    {
+        size_t target = size_t(fullCount / 3 * glm::clamp(lodLevels[i], 0.0f, 1.0f)) * 3;
+        errors[i] = MeshSimplifier::simplify(indices, vertices, target, lodIndices[i]);
+    });
+    
+    // Append the levels to the index buffer after the full mesh
+    ModelLod full = { 0, fullCount, 0.0f };
+    lods.assign(1, full);
+    for (unsigned int i = 0; i < lodLevels.size(); i++)
+    {
+        ModelLod lod = { static_cast<unsigned int>(indices.size()),
+                         static_cast<unsigned int>(lodIndices[i].size()), errors[i] };
+        lods.push_back(lod);
+        indices.insert(indices.end(), lodIndices[i].begin(), lodIndices[i].end());
+        printf("LOD %u: %u triangles, error %g\n", i + 1, lod.indexCount / 3, lod.error);
+    }
+}
+
+void Model::optimise()
+{
+    unsigned int count = static_cast<unsigned int>(vertices.size());
+    std::vector<unsigned int> full(indices.begin(), indices.begin() + lods[0].indexCount);
+    float acmrBefore = MeshOptimiser::acmr(full, count);
+    float atvrBefore = MeshOptimiser::atvr(full, count);
+    
+    // Post-transform cache order, then overdraw order of the resulting
+    // clusters, for each level of detail
+    for (unsigned int i = 0; i < lods.size(); i++)
+    {
+        std::vector<unsigned int> lod(indices.begin() + lods[i].indexOffset,
+                                      indices.begin() + lods[i].indexOffset + lods[i].indexCount);
+        std::vector<unsigned int> clusters;
+        MeshOptimiser::optimiseVertexCache(lod, count, clusters);
+        MeshOptimiser::optimiseOverdraw(lod, vertices, clusters);
+        std::copy(lod.begin(), lod.end(), indices.begin() + lods[i].indexOffset);
+    }
+    
+    // Split the full mesh into meshlets, which regroups its triangles
+    if (useMeshlets)
+    {
+        Meshlets::build(indices, lods[0].indexOffset, lods[0].indexCount, vertices, meshlets);
+        printf("%u meshlets\n", static_cast<unsigned int>(meshlets.size()));
+    }
+    
+    // Store the vertices in the order they are first fetched by the full
+    // mesh, which every level of detail shares
+    std::vector<unsigned int> remap;
+    count = MeshOptimiser::optimiseVertexFetch(indices, count, remap);
+    MeshOptimiser::remapVertices(vertices, remap, count);
+    MeshOptimiser::remapVertices(uvs, remap, count);
+    MeshOptimiser::remapVertices(normals, remap, count);
+    
+    full.assign(indices.begin(), indices.begin() + lods[0].indexCount);
+    printf("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           acmrBefore, MeshOptimiser::acmr(full, count),
+           atvrBefore, MeshOptimiser::atvr(full, count));
 }
 
 bool Model::loadObj(const char *path,
                     std::vector<glm::vec3> &outVertices,
                     std::vector<glm::vec2> &outUVs,
-                    std::vector<glm::vec3> &outNormals)
+                    std::vector<glm::vec3> &outNormals,
+                    std::vector<unsigned int> &outIndices)
 {
     
     printf("Loading file %s\n", path);
     
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<glm::vec3> tempVertices;
-    std::vector<glm::vec2> tempUVs;
-    std::vector<glm::vec3> tempNormals;
-    
-    FILE *file = fopen(path, "r");
-    if (file==NULL)
+    // Map the whole file into memory
+    MappedFile file(path);
+    if (!file.isOpen())
     {
-        printf("Impossible to open the file. Check paths and directories.");
-        getchar();
+        printf("Impossible to open the file. Check paths and directories.\n");
         return false;
     }
     
-    while (true)
+    // Split the file into chunks that start at the beginning of a line
+    const char *begin = file.data();
+    const char *end   = begin + file.size();
+    ThreadPool &pool  = ThreadPool::shared();
+    size_t numChunks  = file.size() / minChunkSize;
+    if (numChunks > 4 * pool.size())
+        numChunks = 4 * pool.size();
+    if (numChunks < 1 || pool.size() < 2)
+        numChunks = 1;
+    
+    std::vector<const char *> bounds(1, begin);
+    for (size_t i = 1; i < numChunks; i++)
     {
-        // Read the first word of the line
-        char lineHeader[128];
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
+        const char *p = begin + file.size() / numChunks * i;
+        if (p < bounds.back())
+            p = bounds.back();
+        while (p < end && *p != '\n')
+            p++;
+        bounds.push_back(p < end ? p + 1 : end);
+    }
+    bounds.push_back(end);
+    
+    // Tokenise the chunks in parallel
+    std::vector<ObjData> chunks(numChunks);
+    std::vector<char> parsed(numChunks);
+    pool.parallelFor(static_cast<unsigned int>(numChunks), [&](unsigned int i)
+    {
+        parsed[i] = parseObj(bounds[i], bounds[i + 1], chunks[i]);
+    });
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        if (!parsed[i])
         {
-            // If end of file reached exit the loop
-            break;
+            printf("File can't be read by loadObj().\n");
+            return false;
         }
-        
-        if (strcmp(lineHeader, "v") == 0)
+    }
+    
+    // Prefix sum the chunk sizes to find where each chunk goes in the merged arrays
+    std::vector<size_t> vertexBase(numChunks + 1, 0), uvBase(numChunks + 1, 0);
+    std::vector<size_t> normalBase(numChunks + 1, 0), cornerBase(numChunks + 1, 0);
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        vertexBase[i + 1] = vertexBase[i] + chunks[i].vertices.size();
+        uvBase[i + 1]     = uvBase[i]     + chunks[i].uvs.size();
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].vertexIndices.size();
+    }
+    
+    // Merge the attributes (a single chunk can be used as it is)
+    std::vector<glm::vec3> mergedVertices, mergedNormals;
+    std::vector<glm::vec2> mergedUVs;
+    if (numChunks == 1)
+    {
+        mergedVertices.swap(chunks[0].vertices);
+        mergedUVs.swap(chunks[0].uvs);
+        mergedNormals.swap(chunks[0].normals);
+    }
+    else
+    {
+        mergedVertices.resize(vertexBase[numChunks]);
+        mergedUVs.resize(uvBase[numChunks]);
+        mergedNormals.resize(normalBase[numChunks]);
+        pool.parallelFor(static_cast<unsigned int>(numChunks), [&](unsigned int i)
         {
-            // Read vertices
-            glm::vec3 vertex;
-            fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-            tempVertices.push_back(vertex);
+            std::copy(chunks[i].vertices.begin(), chunks[i].vertices.end(), mergedVertices.begin() + vertexBase[i]);
+            std::copy(chunks[i].uvs.begin(),      chunks[i].uvs.end(),      mergedUVs.begin()      + uvBase[i]);
+            std::copy(chunks[i].normals.begin(),  chunks[i].normals.end(),  mergedNormals.begin()  + normalBase[i]);
+        });
+    }
+    
+    // Resolve the face indices of each chunk into (v, vt, vn) triples,
+    // checking for references to attributes that were never defined
+    std::vector<ObjCorner> corners(cornerBase[numChunks]);
+    pool.parallelFor(static_cast<unsigned int>(numChunks), [&](unsigned int i)
+    {
+        const ObjData &chunk = chunks[i];
+        for (size_t j = 0; j < chunk.vertexIndices.size(); j++)
+        {
+            size_t vertexIndex, uvIndex, normalIndex;
+            if (!decodeIndex(chunk.vertexIndices[j], vertexBase[i], mergedVertices.size(), vertexIndex) ||
+                !decodeIndex(chunk.uvIndices[j],     uvBase[i],     mergedUVs.size(),      uvIndex) ||
+                !decodeIndex(chunk.normalIndices[j], normalBase[i], mergedNormals.size(),  normalIndex))
+            {
+                parsed[i] = false;
+                return;
+            }
+            
+            ObjCorner &corner = corners[cornerBase[i] + j];
+            corner.v  = static_cast<unsigned int>(vertexIndex);
+            corner.vt = static_cast<unsigned int>(uvIndex);
+            corner.vn = static_cast<unsigned int>(normalIndex);
+        }
+    });
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        if (!parsed[i])
+        {
+            printf("File can't be read by loadObj().\n");
+            return false;
         }
-        else if (strcmp(lineHeader, "vt") == 0)
+    }
+    
+    // Give each distinct (v, vt, vn) triple one vertex, in order of first use,
+    // using an open addressing hash table of indices into uniqueCorners
+    std::vector<ObjCorner> uniqueCorners;
+    size_t tableSize = 1;
+    while (tableSize < corners.size() * 2)
+        tableSize *= 2;
+    std::vector<unsigned int> table(tableSize, ~0u);
+    
+    unsigned int outBase = static_cast<unsigned int>(outVertices.size());
+    outIndices.reserve(outIndices.size() + corners.size());
+    for (size_t i = 0; i < corners.size(); i++)
+    {
+        const ObjCorner &corner = corners[i];
+        size_t slot = hashCorner(corner) & (tableSize - 1);
+        while (table[slot] != ~0u && !(uniqueCorners[table[slot]] == corner))
+            slot = (slot + 1) & (tableSize - 1);
+        
+        if (table[slot] == ~0u)
         {
-            // Read texture co-ordinates
-            glm::vec2 uv;
-            fscanf(file, "%f %f\n", &uv.x, &uv.y);
-            tempUVs.push_back(uv);
+            table[slot] = static_cast<unsigned int>(uniqueCorners.size());
+            uniqueCorners.push_back(corner);
         }
-        else if (strcmp(lineHeader, "vn") == 0)
+        outIndices.push_back(outBase + table[slot]);
+    }
+    
+    // Copy the attributes of each unique vertex to the buffers
+    outVertices.resize(outBase + uniqueCorners.size());
+    outUVs.resize(outBase + uniqueCorners.size());
+    outNormals.resize(outBase + uniqueCorners.size());
+    for (size_t i = 0; i < uniqueCorners.size(); i++)
+    {
+        outVertices[outBase + i] = mergedVertices[uniqueCorners[i].v];
+        outUVs[outBase + i]      = mergedUVs[uniqueCorners[i].vt];
+        outNormals[outBase + i]  = mergedNormals[uniqueCorners[i].vn];
+    }
+    
+    printf("%u vertices, %u triangles\n",
+           static_cast<unsigned int>(uniqueCorners.size()),
+           static_cast<unsigned int>(corners.size() / 3));
+    
+    return true;
+}
+
+void Model::loadGlbScene(const GltfFile &file)
+{
+    // A mesh drawn once keeps its node's transform
+    std::vector<GltfInstance> instances = file.instances();
+    if (instances.size() == 1)
+        transform = instances[0].transform;
+    
+    // Decode the base colour and normal textures of the first material,
+    // leaving them for upload() since this needn't be on the GL thread
+    std::vector<GltfPrimitive> primitives;
+    if (!instances.empty())
+        primitives = file.primitives(instances[0].mesh);
+    if (primitives.empty())
+        return;
+    const char *names[] = { "baseColorTexture", "normalTexture" };
+    const char *types[] = { "diffuse", "normal" };
+    for (int i = 0; i < 2; i++)
+    {
+        const unsigned char *data;
+        size_t size;
+        std::string imagePath;
+        if (!file.textureImage(file.materialTexture(primitives[0].material, names[i]), data, size, imagePath))
+            continue;
+        
+        PendingTexture texture;
+        TextureSettings settings = glbTextureSettings(types[i]);
+        bool read = data != NULL ? TextureCache::read(data, size, settings, texture.data)
+                                 : TextureCache::read(imagePath.c_str(), settings, texture.data);
+        if (!read)
         {
-            // Read vertex normals
-            glm::vec3 normal;
-            fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-            tempNormals.push_back(normal);
+            printf("Texture %s of %s failed to load\n", types[i], imagePath.empty() ? "an embedded image" : imagePath.c_str());
+            continue;
         }
-        else if (strcmp(lineHeader, "f") == 0)
+        texture.type = types[i];
+        pendingTextures.push_back(texture);
+    }
+}
+
+bool Model::mapGlb(const GltfFile &file)
+{
+    // Only a single primitive drawn once, with nothing to build from it, can
+    // be drawn from the file's buffers
+    std::vector<GltfInstance> instances = file.instances();
+    if (instances.size() != 1 || !lodLevels.empty() || useMeshlets || pool != NULL)
+        return false;
+    std::vector<GltfPrimitive> primitives = file.primitives(instances[0].mesh);
+    if (primitives.size() != 1)
+        return false;
+    const GltfPrimitive &primitive = primitives[0];
+    
+    // Each attribute of the layout has to be stored as floats with the same
+    // number of components, in the same number of vertices
+    std::vector<GltfAccessor> attributes;
+    std::vector<VertexPointer> pointers;
+    size_t begin = SIZE_MAX, end = 0;
+    for (size_t i = 0; i < vertexLayout.elements().size(); i++)
+    {
+        const VertexElement &element = vertexLayout.elements()[i];
+        GltfAccessor accessor;
+        GLint components = floatComponents(element.format);
+        if (components == 0 || !file.accessor(primitive.attributes[element.attribute], accessor) ||
+            accessor.componentType != GL_FLOAT || accessor.components != static_cast<unsigned int>(components) ||
+            accessor.offset % 4 != 0 || accessor.stride % 4 != 0 || accessor.count == 0 ||
+            (!attributes.empty() && accessor.count != attributes[0].count))
+            return false;
+        VertexPointer pointer = { element.attribute, components, GL_FLOAT, GL_FALSE,
+                                  static_cast<GLsizei>(accessor.stride), accessor.offset };
+        attributes.push_back(accessor);
+        pointers.push_back(pointer);
+        begin = std::min(begin, accessor.offset);
+        end   = std::max(end, accessor.offset + (accessor.count - 1) * accessor.stride + 4 * components);
+    }
+    if (attributes.empty() || vertexLayout.elements()[0].attribute != AttributePosition)
+        return false;
+    
+    // And the indices have to be packed 16 or 32-bit integers
+    GltfAccessor indexAccessor;
+    if (!file.accessor(primitive.indices, indexAccessor) || indexAccessor.components != 1 ||
+        (indexAccessor.componentType != GL_UNSIGNED_SHORT && indexAccessor.componentType != GL_UNSIGNED_INT) ||
+        indexAccessor.stride != (indexAccessor.componentType == GL_UNSIGNED_SHORT ? 2u : 4u) ||
+        indexAccessor.offset % indexAccessor.stride != 0)
+        return false;
+    
+    // Upload the span of the binary chunk holding the vertices, pointing the
+    // attributes into it
+    for (size_t i = 0; i < pointers.size(); i++)
+        pointers[i].offset -= begin;
+    vertexPointers   = pointers;
+    directVertexSize = end - begin;
+    vertexCount      = attributes[0].count;
+    indexCount       = indexAccessor.count;
+    indexType        = indexAccessor.componentType;
+    lods[0].indexOffset = 0;
+    lods[0].indexCount  = indexCount;
+    lods[0].error       = 0.0f;
+    pendingCache     = file.file();
+    pendingVertices  = attributes[0].data - (attributes[0].offset - begin);
+    pendingIndices   = indexAccessor.data;
+    
+    // Find the bounding volumes, keeping the positions and triangles if wanted
+    std::vector<float> positions;
+    file.readFloats(primitive.attributes[AttributePosition], 3, positions);
+    const glm::vec3 *points = reinterpret_cast<const glm::vec3 *>(positions.data());
+    computeBounds(points, vertexCount);
+    if (keepPositions)
+    {
+        vertices.assign(points, points + vertexCount);
+        file.readIndices(primitive.indices, indices);
+    }
+    
+    printf("Using the buffers of the file as they are: %u vertices, %u triangles\n", vertexCount, indexCount / 3);
+    return true;
+}
+
+bool Model::loadGlb(const GltfFile &file,
+                    std::vector<glm::vec3> &inVertices,
+                    std::vector<glm::vec2> &inUVs,
+                    std::vector<glm::vec3> &inNormals,
+                    std::vector<unsigned int> &inIndices)
+{
+    // Merge the primitives of every mesh the scene draws, moving them to
+    // where their nodes put them if there are several
+    std::vector<GltfInstance> instances = file.instances();
+    bool merge = instances.size() > 1;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        glm::mat4 toScene  = instances[i].transform;
+        glm::mat3 toNormal = glm::transpose(glm::inverse(glm::mat3(toScene)));
+        std::vector<GltfPrimitive> primitives = file.primitives(instances[i].mesh);
+        for (size_t j = 0; j < primitives.size(); j++)
         {
-            // Read vertex indices
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n",
-                                 &vertexIndex[0], &uvIndex[0], &normalIndex[0],
-                                 &vertexIndex[1], &uvIndex[1], &normalIndex[1],
-                                 &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
+            const GltfPrimitive &primitive = primitives[j];
+            std::vector<float> positions, uvs, normals;
+            std::vector<unsigned int> triangles;
+            if (!file.readFloats(primitive.attributes[AttributePosition], 3, positions))
+            {
+                printf("A primitive of mesh %u has no readable positions\n", instances[i].mesh);
+                continue;
+            }
+            size_t count = positions.size() / 3;
+            if (!file.readFloats(primitive.attributes[AttributeUV], 2, uvs))
+                uvs.assign(2 * count, 0.0f);
+            if (!file.readFloats(primitive.attributes[AttributeNormal], 3, normals))
+                normals.assign(3 * count, 0.0f);
+            if (!file.readIndices(primitive.indices, triangles))
+            {
+                triangles.resize(count - count % 3);
+                for (unsigned int k = 0; k < triangles.size(); k++)
+                    triangles[k] = k;
+            }
             
-            // Check for error
-            if (matches != 9)
+            // Append them, dropping triangles with indices out of range
+            unsigned int first = static_cast<unsigned int>(inVertices.size());
+            for (size_t k = 0; k < count; k++)
             {
-                printf("File can't be read by loadObj().\n");
-                fclose(file);
-                return false;
+                glm::vec3 position(positions[3 * k], positions[3 * k + 1], positions[3 * k + 2]);
+                glm::vec3 normal(normals[3 * k], normals[3 * k + 1], normals[3 * k + 2]);
+                if (merge)
+                {
+                    position = glm::vec3(toScene * glm::vec4(position, 1.0f));
+                    if (glm::length(normal) > 0.0f)
+                        normal = glm::normalize(toNormal * normal);
+                }
+                inVertices.push_back(position);
+                inUVs.push_back(glm::vec2(uvs[2 * k], uvs[2 * k + 1]));
+                inNormals.push_back(normal);
             }
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            uvIndices    .push_back(uvIndex[0]);
-            uvIndices    .push_back(uvIndex[1]);
-            uvIndices    .push_back(uvIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
+            for (size_t k = 0; k + 2 < triangles.size(); k += 3)
+                if (triangles[k] < count && triangles[k + 1] < count && triangles[k + 2] < count)
+                    for (int corner = 0; corner < 3; corner++)
+                        inIndices.push_back(first + triangles[k + corner]);
         }
-        else
+    }
+    
+    printf("%u vertices, %u triangles\n", static_cast<unsigned int>(inVertices.size()),
+           static_cast<unsigned int>(inIndices.size() / 3));
+    return !inVertices.empty();
+}
+
+bool Model::streamObj(const char *path)
+{
+    printf("Streaming file %s\n", path);
+    
+    MappedFile file(path);
+    if (!file.isOpen())
+    {
+        printf("Impossible to open the file. Check paths and directories.\n");
+        return false;
+    }
+    
+    // Faces can refer back to attributes anywhere before them, so spill the
+    // attributes to files that are mapped back in afterwards, and the
+    // resolved face corners to a file that is read through once
+    SpillFile vertexSpill, uvSpill, normalSpill;
+    std::shared_ptr<FILE> cornerFile = temporaryFile();
+    if (vertexSpill.file == NULL || uvSpill.file == NULL || normalSpill.file == NULL || !cornerFile)
+    {
+        printf("Couldn't create temporary files for %s\n", path);
+        return false;
+    }
+    
+    // Parse a window at a time, ending each at the end of a line, and drop
+    // the pages of the file that have been read
+    const char *begin = file.data();
+    const char *end   = begin + file.size();
+    size_t vertexTotal = 0, uvTotal = 0, normalTotal = 0, cornerTotal = 0;
+    std::vector<ObjCorner> corners;
+    while (begin < end)
+    {
+        const char *windowEnd = begin + std::min(streamWindow, size_t(end - begin));
+        while (windowEnd < end && windowEnd[-1] != '\n')
+            windowEnd++;
+        
+        ObjData window;
+        bool parsed = parseObj(begin, windowEnd, window);
+        corners.resize(window.vertexIndices.size());
+        for (size_t j = 0; parsed && j < corners.size(); j++)
+        {
+            size_t vertexIndex = 0, uvIndex = 0, normalIndex = 0;
+            parsed = decodeIndex(window.vertexIndices[j], vertexTotal, vertexTotal + window.vertices.size(), vertexIndex) &&
+                     decodeIndex(window.uvIndices[j],     uvTotal,     uvTotal + window.uvs.size(),          uvIndex) &&
+                     decodeIndex(window.normalIndices[j], normalTotal, normalTotal + window.normals.size(),  normalIndex);
+            if (parsed)
+            {
+                corners[j].v  = static_cast<unsigned int>(vertexIndex);
+                corners[j].vt = static_cast<unsigned int>(uvIndex);
+                corners[j].vn = static_cast<unsigned int>(normalIndex);
+            }
+        }
+        if (!parsed)
         {
-            // Remove comment line
-            char commentBuffer[1000];
-            fgets(commentBuffer, 1000, file);
+            printf("File can't be read by loadObj().\n");
+            return false;
         }
+        
+        // Grow the bounding volumes of the windows before
+        glm::vec3 windowMin, windowMax;
+        BoundingVolumes::box(window.vertices.data(), window.vertices.size(), windowMin, windowMax);
+        if (vertexTotal == 0)
+        {
+            boundsMin = windowMin;
+            boundsMax = windowMax;
+            boundingSphere = BoundingVolumes::sphere(window.vertices.data(), window.vertices.size());
+        }
+        else if (!window.vertices.empty())
+        {
+            boundsMin = glm::min(boundsMin, windowMin);
+            boundsMax = glm::max(boundsMax, windowMax);
+            BoundingVolumes::grow(boundingSphere, window.vertices.data(), window.vertices.size());
+        }
+        fwrite(window.vertices.data(), sizeof(glm::vec3), window.vertices.size(), vertexSpill.file);
+        fwrite(window.uvs.data(),      sizeof(glm::vec2), window.uvs.size(),      uvSpill.file);
+        fwrite(window.normals.data(),  sizeof(glm::vec3), window.normals.size(),  normalSpill.file);
+        fwrite(corners.data(),         sizeof(ObjCorner), corners.size(),         cornerFile.get());
+        vertexTotal += window.vertices.size();
+        uvTotal     += window.uvs.size();
+        normalTotal += window.normals.size();
+        cornerTotal += corners.size();
+        
+        file.release(begin, windowEnd - begin);
+        begin = windowEnd;
     }
+    file.close();
+    
+    fflush(vertexSpill.file);
+    fflush(uvSpill.file);
+    fflush(normalSpill.file);
+    MappedFile vertexMap(vertexSpill.path.c_str()), uvMap(uvSpill.path.c_str()), normalMap(normalSpill.path.c_str());
+    const glm::vec3 *allVertices = reinterpret_cast<const glm::vec3 *>(vertexMap.data());
+    const glm::vec2 *allUVs      = reinterpret_cast<const glm::vec2 *>(uvMap.data());
+    const glm::vec3 *allNormals  = reinterpret_cast<const glm::vec3 *>(normalMap.data());
     
-    // For each vertex of the triangle
-    for (unsigned int i = 0; i < vertexIndices.size(); i++)
+    // Give each distinct (v, vt, vn) triple within a window of corners one
+    // vertex, encode them and spill them with their indices for upload.
+    // Vertices shared across windows are duplicated, which costs a little
+    // memory but keeps the table the size of a window.
+    pendingVertexFile = temporaryFile();
+    pendingIndexFile  = temporaryFile();
+    if (!pendingVertexFile || !pendingIndexFile)
     {
-        // Get the indices of its attributes
-        unsigned int vertexIndex = vertexIndices[i];
-        unsigned int uvIndex = uvIndices[i];
-        unsigned int normalIndex = normalIndices[i];
+        printf("Couldn't create temporary files for %s\n", path);
+        return false;
+    }
+    
+    size_t cornersPerWindow = std::max<size_t>(3, streamWindow / sizeof(ObjCorner) / 3 * 3);
+    size_t tableSize = 1;
+    while (tableSize < cornersPerWindow * 2)
+        tableSize *= 2;
+    std::vector<unsigned int> table, windowIndices;
+    std::vector<ObjCorner> uniqueCorners;
+    std::vector<glm::vec3> windowVertices, windowNormals;
+    std::vector<glm::vec2> windowUVs;
+    std::vector<unsigned char> vertexData;
+    corners.resize(cornersPerWindow);
+    rewind(cornerFile.get());
+    
+    size_t totalVertices = 0;
+    while (size_t count = fread(corners.data(), sizeof(ObjCorner), cornersPerWindow, cornerFile.get()))
+    {
+        table.assign(tableSize, ~0u);
+        uniqueCorners.clear();
+        windowIndices.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const ObjCorner &corner = corners[i];
+            size_t slot = hashCorner(corner) & (tableSize - 1);
+            while (table[slot] != ~0u && !(uniqueCorners[table[slot]] == corner))
+                slot = (slot + 1) & (tableSize - 1);
+            
+            if (table[slot] == ~0u)
+            {
+                table[slot] = static_cast<unsigned int>(uniqueCorners.size());
+                uniqueCorners.push_back(corner);
+            }
+            windowIndices[i] = static_cast<unsigned int>(totalVertices) + table[slot];
+        }
         
-        // Get the attributes
-        glm::vec3 vertex = tempVertices[vertexIndex - 1];
-        glm::vec2 uv = tempUVs[uvIndex - 1];
-        glm::vec3 normal = tempNormals[normalIndex - 1];
+        windowVertices.resize(uniqueCorners.size());
+        windowUVs.resize(uniqueCorners.size());
+        windowNormals.resize(uniqueCorners.size());
+        for (size_t i = 0; i < uniqueCorners.size(); i++)
+        {
+            windowVertices[i] = allVertices[uniqueCorners[i].v];
+            windowUVs[i]      = allUVs[uniqueCorners[i].vt];
+            windowNormals[i]  = allNormals[uniqueCorners[i].vn];
+        }
         
-        // Copy the attributes to the buffers
-        outVertices.push_back(vertex);
-        outUVs.push_back(uv);
-        outNormals.push_back(normal);
+        VertexStreams streams;
+        streams.positions = &windowVertices;
+        streams.uvs       = &windowUVs;
+        streams.normals   = &windowNormals;
+        VertexEncoder::encode(vertexLayout, streams, static_cast<unsigned int>(uniqueCorners.size()),
+                              boundsMin, boundsMax, vertexData);
+        fwrite(vertexData.data(), 1, vertexData.size(), pendingVertexFile.get());
+        fwrite(windowIndices.data(), sizeof(unsigned int), count, pendingIndexFile.get());
+        totalVertices += uniqueCorners.size();
     }
     
-    // Close .obj file
-    fclose(file);
+    if (totalVertices > 0xFFFFFFFFu || cornerTotal > 0xFFFFFFFFu)
+    {
+        printf("%s has too many vertices for 32-bit indices.\n", path);
+        pendingVertexFile.reset();
+        pendingIndexFile.reset();
+        return false;
+    }
+    vertexCount = static_cast<unsigned int>(totalVertices);
+    indexCount  = static_cast<unsigned int>(cornerTotal);
+    indexType   = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    ModelLod full = { 0, indexCount, 0.0f };
+    lods.assign(1, full);
     
+    printf("%u vertices, %u triangles\n", vertexCount, indexCount / 3);
     return true;
 }
 
-void Model::addTexture(const char *path, const std::string type)
+void Model::addTexture(const char *path, const std::string type, const TextureSettings &settings)
+{
+    addTexture(TextureCache::shared().get(path, settings), type);
+}
+
+void Model::addTexture(unsigned int id, const std::string type)
 {
     Texture texture;
-    texture.id = loadTexture(path);
+    texture.id = id;
     texture.type = type;
     textures.push_back(texture);
 }
 
-unsigned int Model::loadTexture(const char *path)
+void Model::addTexture(TextureHandle handle, const std::string type)
 {
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, numComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &numComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (numComponents == 1)
-            format = GL_RED;
-        else if (numComponents == 3)
-            format = GL_RGB;
-        else if (numComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture " << path << " failed to load." << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    Texture texture;
+    texture.id = *handle;
+    texture.type = type;
+    texture.handle = handle;
+    textures.push_back(texture);
 }
@@ -1,59 +1,301 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <stdio.h>
 #include <string>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <common/bounds.hpp>
+#include <common/geometrypool.hpp>
+#include <common/globject.hpp>
+#include <common/gltf.hpp>
+#include <common/mappedfile.hpp>
+#include <common/meshlets.hpp>
+#include <common/texturecache.hpp>
+#include <common/vertexformat.hpp>
+
 // Texture struct
 struct Texture
 {
     unsigned int id;
     std::string type;
+    TextureHandle handle;   // keeps the texture alive (empty if owned elsewhere)
+};
+
+// Range of the index buffer holding one level of detail
+struct ModelLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float        error;        // simplification error in model units
+};
+
+// Settings for loading a Model
+struct ModelOptions
+{
+    // Attributes and formats of the interleaved vertex buffer (tangents are
+    // generated if it has them)
+    VertexLayout vertexLayout = VertexLayout::standard();
+    
+    // Also upload a separate position only buffer for depth and shadow passes
+    bool positionStream = false;
+    
+    // Fraction of the triangles kept by each coarser level of detail, e.g.
+    // { 0.5f, 0.25f, 0.1f } (none by default)
+    std::vector<float> lodLevels;
+    
+    // Largest simplification error, in pixels on a screen lodScreenHeight
+    // pixels high, allowed when picking a level of detail
+    float lodPixelError   = 1.0f;
+    float lodScreenHeight = 768.0f;
+    
+    // Also work out a box along the principal axes of the mesh, on top of
+    // the axis-aligned box and the sphere every model has (not for streamed
+    // models)
+    bool orientedBox = false;
+    
+    // Split the full mesh into meshlets that are culled on the CPU when
+    // drawing with matrices
+    bool meshlets = false;
+    
+    // Free the CPU copy of the mesh once it is uploaded, keeping only the
+    // counts, bounds, levels of detail and meshlets
+    bool releaseMesh = false;
+    
+    // Keep the positions and the triangles of the full mesh in vertices and
+    // indices, for picking and collision, even when the mesh is released or
+    // loaded from its cache
+    bool keepPositions = false;
+    
+    // Read the .obj file in windows of this many bytes, spilling the vertices
+    // and indices to temporary files and uploading them in pieces, so files
+    // bigger than memory can be loaded (0 reads the whole file at once).
+    // Streamed models skip the levels of detail, optimisation, meshlets,
+    // tangents and the mesh cache, which all need the whole mesh in memory.
+    size_t streamWindow = 0;
+    
+    // Pack the mesh into a shared pool instead of buffers of its own, if the
+    // vertex layouts match (the pool's position stream is used in place of
+    // positionStream)
+    GeometryPool *pool = NULL;
 };
 
 class Model
 {
 public:
-    // Model attributes
+    // Model attributes (left empty when the model is loaded from its cache or
+    // released after upload, apart from the positions and full mesh indices
+    // if they are kept)
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec2> uvs;
     std::vector<glm::vec3> normals;
+    std::vector<glm::vec4> tangents;    // bitangent sign in w (only if the layout has tangents)
+    std::vector<unsigned int> indices;
     std::vector<Texture>   textures;
     unsigned int textureID;
     float ka, kd, ks, Ns;
     
-    // Constructor
-    Model(const char *path);
+    // Bounding box and sphere, and the oriented bounding box if it was asked
+    // for (with zero extents otherwise)
+    glm::vec3 boundsMin, boundsMax;
+    BoundingSphere boundingSphere;
+    OrientedBox orientedBox;
+    
+    // Transform from the model to the scene it was loaded from (identity
+    // unless it is a .glb file drawing its mesh once, from a node with a
+    // transform, since the meshes of several nodes are merged in place)
+    glm::mat4 transform;
+    
+    // Levels of detail, from the full mesh down
+    std::vector<ModelLod> lods;
+    
+    // Meshlets of the full mesh and the results of culling them in the last
+    // draw with matrices (all zero if it drew a coarser level of detail)
+    std::vector<Meshlet> meshlets;
+    MeshletStats meshletStats;
+    
+    // Constructor (loads and uploads the model before returning). Models are
+    // read from .obj files, or from binary glTF (.glb) files along with the
+    // base colour and normal textures of their first material.
+    Model(const char *path, const ModelOptions &options = ModelOptions());
+    
+    // Whether the buffers have been uploaded. Models from an AssetLoader
+    // draw their placeholder until then.
+    bool isReady() const { return ready; }
+    
+    // Bounds of the model as drawn with a model matrix, e.g. an object's
+    // translation, rotation and scale, worked out from the stored bounds
+    Bounds worldBounds(const glm::mat4 &model) const;
+    
+    // Bytes of vertex and index data sent to the GPU
+    size_t uploadSize() const;
     
     // Draw model
     void draw(unsigned int &shaderID);
     
-    // Add textures
-    void addTexture(const char *path, const std::string type);
+    // Draw the coarsest level of detail that looks the same at the size the
+    // model appears on screen, culling the meshlets of the full mesh
+    void draw(unsigned int &shaderID, const glm::mat4 &MV, const glm::mat4 &projection);
+    
+    // Pick the level of detail for drawing with the given matrices
+    unsigned int selectLod(const glm::mat4 &MV, const glm::mat4 &projection) const;
     
-    // Cleanup
+    // Draw model fetching positions only (for depth and shadow passes)
+    void drawDepth(unsigned int &shaderID);
+    
+    // Add textures, loading them from a file through the shared TextureCache
+    // or using an existing texture
+    void addTexture(const char *path, const std::string type, const TextureSettings &settings = TextureSettings());
+    void addTexture(unsigned int id, const std::string type);
+    void addTexture(TextureHandle texture, const std::string type);
+    
+    // Cleanup (frees the buffers and textures now rather than when the model
+    // is destroyed)
     void deleteBuffers();
     
 private:
+    friend class AssetLoader;
+    friend class AssetManager;
+    
+    // Empty model for AssetLoader to load into
+    Model();
     
-    // Array buffers
-    unsigned int VAO;
-    unsigned int vertexBuffer;
-    unsigned int uvBuffer;
-    unsigned int normalBuffer;
+    // Read the model from its cache or its .obj file, leaving the data to
+    // upload in the pending members (safe to call on any thread)
+    void load(const char *path, const ModelOptions &options);
+    
+    // Upload the pending data to the GPU and free it (on the GL thread)
+    void upload();
+    
+    // Take the mesh of a freshly loaded copy of the model and upload it into
+    // this model's buffers, keeping its material (on the GL thread)
+    void replaceMesh(Model &fresh);
+    
+    // Upload state and what to draw until then
+    bool ready;
+    Model *placeholder;
+    
+    // Data waiting for upload(), either in the mapped cache or in copies
+    std::shared_ptr<MappedFile> pendingCache;
+    std::vector<unsigned char> pendingVertexData;
+    std::vector<unsigned short> pendingShortIndices;
+    const void *pendingVertices;
+    const void *pendingIndices;
+    
+    // Data of a streamed model waiting for upload, in temporary files, and
+    // the size of the pieces it is read and uploaded in
+    std::shared_ptr<FILE> pendingVertexFile;
+    std::shared_ptr<FILE> pendingIndexFile;
+    size_t streamWindow;
+    
+    // Textures of a .glb file, read and waiting for upload()
+    struct PendingTexture
+    {
+        std::string type;
+        TextureData data;
+    };
+    std::vector<PendingTexture> pendingTextures;
+    
+    // Attributes of vertex data uploaded as it was stored, and its size
+    // (empty unless the vertices came straight from a .glb file)
+    std::vector<VertexPointer> vertexPointers;
+    size_t directVertexSize;
+    
+    // Array buffers (Models can't be copied, only moved, since they own these)
+    GLVertexArray VAO;
+    GLBuffer vertexBuffer;
+    GLBuffer indexBuffer;
+    GLVertexArray depthVAO;
+    GLBuffer positionBuffer;
+    
+    // Pool holding the mesh instead, and where in it
+    GeometryPool *pool;
+    std::shared_ptr<GeometryRange> poolRange;
+    
+    // Vertex buffer layout and indexed draw parameters
+    VertexLayout vertexLayout;
+    bool positionStream;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    GLenum indexType;
+    
+    // Level of detail settings
+    std::vector<float> lodLevels;
+    float lodPixelError;
+    float lodScreenHeight;
+    
+    // What to keep of the CPU copy of the mesh after upload
+    bool releaseMesh;
+    bool keepPositions;
+    
+    // Whether to work out the oriented bounding box
+    bool useOrientedBox;
+    
+    // Meshlet culling settings and scratch space for the draws it leaves
+    bool useMeshlets;
+    std::vector<unsigned int> drawOffsets, drawCounts;
+    std::vector<GLsizei> drawSizes;
+    std::vector<const void *> drawPointers;
+    std::vector<GLint> drawBaseVertices;
     
     // Load .obj file method
     bool loadObj(const char *path,
                  std::vector<glm::vec3> &inVertices,
                  std::vector<glm::vec2> &inUVs,
-                 std::vector<glm::vec3> &inNormals);
+                 std::vector<glm::vec3> &inNormals,
+                 std::vector<unsigned int> &inIndices);
+    
+    // Decode the material textures of a .glb file and take the transform of
+    // a mesh drawn once
+    void loadGlbScene(const GltfFile &file);
+    
+    // Use the buffers of a .glb file as they are, returning false if they
+    // haven't got the layout and attributes asked for
+    bool mapGlb(const GltfFile &file);
+    
+    // Read the meshes of a .glb file, merging the meshes of several nodes
+    bool loadGlb(const GltfFile &file,
+                 std::vector<glm::vec3> &inVertices,
+                 std::vector<glm::vec2> &inUVs,
+                 std::vector<glm::vec3> &inNormals,
+                 std::vector<unsigned int> &inIndices);
+    
+    // Read an .obj file a window at a time into the pending files
+    bool streamObj(const char *path);
+    
+    // Fill the buffers from the pending files a window at a time
+    void streamBuffers();
+    
+    // Work out the bounding volumes of positions
+    void computeBounds(const glm::vec3 *positions, size_t count);
+    
+    // Simplify the mesh into the levels of detail, appending their indices
+    void buildLods();
+    
+    // Reorder triangles and vertices for the post-transform cache, overdraw
+    // and vertex fetch
+    void optimise();
+    
+    // Draw one level of detail, or the visible meshlets of the full mesh
+    void drawLod(unsigned int &shaderID, unsigned int lod);
+    void drawMeshlets(unsigned int &shaderID, const glm::mat4 &MV, const glm::mat4 &projection);
+    
+    // Vertex array to draw with, the vertex its indices count from and the
+    // byte offset of its indices (both 0 unless the mesh is in a pool)
+    unsigned int vertexArray(bool depth) const;
+    GLint baseVertex() const;
+    size_t indexStart() const;
+    
+    // Send the material and bind the textures
+    void bindMaterial(unsigned int &shaderID);
     
-    // Setup buffers
-    void setupBuffers();
+    // Send the uniforms the vertex shaders need to decode the vertex layout
+    void sendVertexDecoding(unsigned int shaderID);
     
-    // Load texture
-    unsigned int loadTexture(const char *path);
+    // Setup buffers from interleaved vertex data and indices of type indexType
+    // (left to be filled in if they are NULL)
+    void setupBuffers(const void *vertexData, const void *indexData);
 };
@@ -4,8 +4,8 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
-#include <fstream>
-#include <sstream>
+
+#include <common/archive.hpp>
 
 unsigned int LoadShaders(const char *vertex_file_path,
                          const char *fragment_file_path)
@@ -17,14 +17,7 @@ unsigned int LoadShaders(const char *vertex_file_path,
 
     // Read the Vertex Shader code from the file
     std::string VertexShaderCode;
-    std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-    if(VertexShaderStream.is_open()){
-        std::stringstream sstr;
-        sstr << VertexShaderStream.rdbuf();
-        VertexShaderCode = sstr.str();
-        VertexShaderStream.close();
-    }
-    else
+    if (!readAsset(vertex_file_path, VertexShaderCode))
     {
         printf("Impossible to open %s. Are you in the right directory?\n", 
                vertex_file_path);
@@ -34,13 +27,12 @@ unsigned int LoadShaders(const char *vertex_file_path,
 
     // Read the Fragment Shader code from the file
     std::string FragmentShaderCode;
-    std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-    if(FragmentShaderStream.is_open())
+    if (!readAsset(fragment_file_path, FragmentShaderCode))
     {
-        std::stringstream sstr;
-        sstr << FragmentShaderStream.rdbuf();
-        FragmentShaderCode = sstr.str();
-        FragmentShaderStream.close();
+        printf("Impossible to open %s. Are you in the right directory?\n", 
+               fragment_file_path);
+        getchar();
+        return 0;
     }
 
     GLint Result = GL_FALSE;
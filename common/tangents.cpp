@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cmath>
+
+#include <common/tangents.hpp>
+#include <common/threadpool.hpp>
+
+namespace
+{
+    // Items handled by each task of a parallel loop
+    const unsigned int blockSize = 4096;
+
+    // Any unit vector perpendicular to n
+    glm::vec3 perpendicular(const glm::vec3 &n)
+    {
+        glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::normalize(glm::cross(n, axis));
+    }
+}
+
+void Tangents::generate(const std::vector<unsigned int> &indices, unsigned int indexCount,
+                        const std::vector<glm::vec3> &positions,
+                        const std::vector<glm::vec2> &uvs,
+                        const std::vector<glm::vec3> &normals,
+                        std::vector<glm::vec4> &tangents)
+{
+    unsigned int vertexCount   = static_cast<unsigned int>(positions.size());
+    unsigned int triangleCount = indexCount / 3;
+    bool hasUVs = uvs.size() == positions.size();
+    ThreadPool &pool = ThreadPool::shared();
+
+    // Tangent and bitangent directions of each triangle, from how the
+    // texture co-ordinates change along its edges, and its corner angles
+    std::vector<glm::vec3> faceTangents(triangleCount), faceBitangents(triangleCount);
+    std::vector<float> angles(indexCount);
+    pool.parallelFor((triangleCount + blockSize - 1) / blockSize, [&](unsigned int block)
+    {
+        unsigned int end = std::min(triangleCount, (block + 1) * blockSize);
+        for (unsigned int t = block * blockSize; t < end; t++)
+        {
+            const unsigned int *corner = &indices[3 * t];
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                glm::vec3 a = positions[corner[(k + 1) % 3]] - positions[corner[k]];
+                glm::vec3 b = positions[corner[(k + 2) % 3]] - positions[corner[k]];
+                float lengths = glm::length(a) * glm::length(b);
+                angles[3 * t + k] = lengths > 0.0f ? std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f)) : 0.0f;
+            }
+
+            faceTangents[t]   = glm::vec3(0.0f);
+            faceBitangents[t] = glm::vec3(0.0f);
+            if (!hasUVs)
+                continue;
+
+            glm::vec3 edge1 = positions[corner[1]] - positions[corner[0]];
+            glm::vec3 edge2 = positions[corner[2]] - positions[corner[0]];
+            glm::vec2 duv1  = uvs[corner[1]] - uvs[corner[0]];
+            glm::vec2 duv2  = uvs[corner[2]] - uvs[corner[0]];
+            float det = duv1.x * duv2.y - duv2.x * duv1.y;
+            if (std::fabs(det) < 1e-12f)
+                continue;
+
+            glm::vec3 tangent   = (edge1 * duv2.y - edge2 * duv1.y) / det;
+            glm::vec3 bitangent = (edge2 * duv1.x - edge1 * duv2.x) / det;
+            float length = glm::length(tangent);
+            if (length > 0.0f)
+                faceTangents[t] = tangent / length;
+            faceBitangents[t] = bitangent;
+        }
+    });
+
+    // Triangles around each vertex
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int i = 0; i < indexCount; i++)
+        offsets[indices[i] + 1]++;
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> corners(indexCount);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int i = 0; i < indexCount; i++)
+        corners[fill[indices[i]]++] = i;
+
+    // Gather the triangles' tangents into each vertex, in the plane of its
+    // normal, and pick the handedness the bitangents agree with most
+    tangents.resize(vertexCount);
+    pool.parallelFor((vertexCount + blockSize - 1) / blockSize, [&](unsigned int block)
+    {
+        unsigned int end = std::min(vertexCount, (block + 1) * blockSize);
+        for (unsigned int v = block * blockSize; v < end; v++)
+        {
+            glm::vec3 n = normals.size() == positions.size() && glm::length(normals[v]) > 0.0f
+                        ? glm::normalize(normals[v]) : glm::vec3(0.0f, 0.0f, 1.0f);
+            glm::vec3 tangent(0.0f), bitangent(0.0f);
+            for (unsigned int c = offsets[v]; c < offsets[v + 1]; c++)
+            {
+                unsigned int t = corners[c] / 3;
+                float angle = angles[corners[c]];
+                tangent   += angle * (faceTangents[t] - n * glm::dot(n, faceTangents[t]));
+                bitangent += angle * (faceBitangents[t] - n * glm::dot(n, faceBitangents[t]));
+            }
+
+            float length = glm::length(tangent);
+            tangent = length > 1e-6f ? tangent / length : perpendicular(n);
+            float sign = glm::dot(glm::cross(n, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+            tangents[v] = glm::vec4(tangent, sign);
+        }
+    });
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Generation of per-vertex tangent frames for normal mapping
+class Tangents
+{
+public:
+    // Work out a unit tangent for each vertex, orthogonal to its normal, from
+    // the first indexCount indices. The sign of the bitangent goes in w, so
+    // bitangent = w * cross(normal, tangent). As in MikkTSpace, each triangle
+    // adds its normalised tangent, projected onto the plane of the vertex
+    // normal and weighted by its angle at the vertex, though vertices whose
+    // triangles disagree on handedness aren't split.
+    static void generate(const std::vector<unsigned int> &indices, unsigned int indexCount,
+                         const std::vector<glm::vec3> &positions,
+                         const std::vector<glm::vec2> &uvs,
+                         const std::vector<glm::vec3> &normals,
+                         std::vector<glm::vec4> &tangents);
+};
@@ -1,47 +1,11 @@
-#define STB_IMAGE_IMPLEMENTATION
-#include <common/stb_image.hpp>
+#include <common/texturecache.hpp>
 
-unsigned int loadTexture(const char *path)
+// Load a texture, sharing it with earlier loads of the same file and settings.
+// The shared TextureCache owns the texture, so the id stays valid until it is
+// evicted from there. Call TextureCache::shared().clear() before
+// glfwTerminate() so the textures are deleted while the context is current. KTX files written by texcompress are uploaded block
+// compressed with the mip levels they hold.
+unsigned int loadTexture(const char *path, const TextureSettings &settings = TextureSettings())
 {
-    // Create and bind texture
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    
-    // Load texture image from file
-    int width, height, nChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load(path, &width, &height, &nChannels, 0);
-    
-    if (data)
-    {
-        // Deal with different number of colour channels
-        GLenum format;
-        if (nChannels == 1)
-            format = GL_RED;
-        else if (nChannels == 3)
-            format = GL_RGB;
-        else if (nChannels == 4)
-            format = GL_RGBA;
-        
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        
-        // Set texture wrapping options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
-    }
-    else
-    {
-        printf("Texture %s failed to load.\n", path);
-    }
-
-    // Free the image from the memory
-    stbi_image_free(data);
-    
-    return textureID;
+    return *TextureCache::shared().get(path, settings);
 }
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include <common/imagecache.hpp>
+#include <common/imagedecoder.hpp>
+#include <common/ktx.hpp>
+#include <common/texturecache.hpp>
+
+namespace
+{
+    // Absolute path with links and . and .. resolved (the path as given if
+    // the file isn't on disk, e.g. if it is in the mounted archive)
+    std::string canonicalPath(const char *path)
+    {
+#ifdef _WIN32
+        char resolved[_MAX_PATH];
+        if (_fullpath(resolved, path, _MAX_PATH) != NULL)
+            return resolved;
+#else
+        char resolved[PATH_MAX];
+        if (realpath(path, resolved) != NULL)
+            return resolved;
+#endif
+        return path;
+    }
+
+    bool usesMipmaps(GLenum filter)
+    {
+        return filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_LINEAR_MIPMAP_NEAREST ||
+               filter == GL_NEAREST_MIPMAP_LINEAR  || filter == GL_LINEAR_MIPMAP_LINEAR;
+    }
+
+    // Mip filter to decode a file with, MipmapDriver if the texture has no
+    // mipmaps (images in memory have no name, so they get MipmapBox if they
+    // are left to be picked by name)
+    MipmapFilter mipmapFilter(const TextureSettings &settings, const char *name)
+    {
+        if (!usesMipmaps(settings.minFilter))
+            return MipmapDriver;
+        if (settings.mipmapFilter != MipmapByName)
+            return settings.mipmapFilter;
+        return name != NULL ? Mipmaps::filterFor(name) : MipmapBox;
+    }
+
+    // Upload a decoded image with the sampler state asked for, and its mip
+    // levels if they were built
+    void uploadImage(GLTexture &texture, const DecodedImage &image, const TextureSettings &settings)
+    {
+        GLenum format = GL_RGBA;
+        if (image.components == 1)
+            format = GL_RED;
+        else if (image.components == 2)
+            format = GL_RG;
+        else if (image.components == 3)
+            format = GL_RGB;
+        bool mipmaps = usesMipmaps(settings.minFilter);
+        glBindTexture(GL_TEXTURE_2D, texture.id());
+
+        // Rows of odd sized levels of RGB images aren't 4-byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+        size_t bytes = size_t(image.width) * image.height * image.components;
+        if (mipmaps && image.mipmaps)
+        {
+            const unsigned char *level = image.mipmaps.get();
+            int count = Mipmaps::levelCount(image.width, image.height);
+            for (int i = 1; i <= count; i++)
+            {
+                glTexImage2D(GL_TEXTURE_2D, i, format, Mipmaps::levelWidth(image.width, i),
+                             Mipmaps::levelWidth(image.height, i), 0, format, GL_UNSIGNED_BYTE, level);
+                level += Mipmaps::levelSize(image.width, image.height, image.components, i);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count);
+            bytes += Mipmaps::chainSize(image.width, image.height, image.components);
+        }
+        else if (mipmaps)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            // The mipmaps add a third
+            bytes = bytes * 4 / 3;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, settings.magFilter);
+        texture.setSize(bytes);
+    }
+
+    // Upload a block compressed texture with the mip levels it was stored
+    // with, which the sampler is limited to
+    void uploadCompressed(GLTexture &texture, const CompressedTexture &image, const TextureSettings &settings)
+    {
+        GLenum format = BlockCompression::internalFormat(image.format);
+        glBindTexture(GL_TEXTURE_2D, texture.id());
+        for (size_t level = 0; level < image.levels.size(); level++)
+        {
+            int width = std::max(image.width >> level, 1), height = std::max(image.height >> level, 1);
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), format, width, height, 0,
+                                   static_cast<GLsizei>(image.levels[level].size()), image.levels[level].data());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, settings.magFilter);
+        texture.setSize(KtxFile::size(image));
+    }
+}
+
+TextureCache::TextureCache()
+{
+    decodes = 0;
+    hits    = 0;
+}
+
+TextureCache &TextureCache::shared()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+TextureHandle TextureCache::get(const char *path, const TextureSettings &settings)
+{
+    std::string textureKey = key(path, settings);
+    std::map<std::string, std::shared_ptr<GLTexture> >::const_iterator held = textures.find(textureKey);
+    if (held != textures.end())
+    {
+        hits++;
+        return TextureHandle(held->second, &held->second->id());
+    }
+
+    // Read the file and upload it
+    std::shared_ptr<GLTexture> texture = std::make_shared<GLTexture>(GLTexture::create());
+    TextureData data;
+    decodes++;
+    if (!read(path, settings, data))
+    {
+        // Failures aren't held, so fixing the file and asking again works
+        printf("Texture %s failed to load.\n", path);
+        return TextureHandle(texture, &texture->id());
+    }
+    upload(*texture, data, settings);
+    textures[textureKey] = texture;
+    return TextureHandle(texture, &texture->id());
+}
+
+std::vector<TextureHandle> TextureCache::get(const std::vector<std::string> &paths, const TextureSettings &settings)
+{
+    // Start decoding the files that aren't held, once each
+    ImageDecoder decoder;
+    std::vector<std::string> keys(paths.size());
+    std::vector<std::shared_ptr<GLTexture> > batch(paths.size());
+    std::map<std::string, size_t> first;
+    std::map<unsigned int, size_t> submitted;
+    std::vector<size_t> compressed;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        keys[i] = key(paths[i].c_str(), settings);
+        std::map<std::string, std::shared_ptr<GLTexture> >::const_iterator held = textures.find(keys[i]);
+        if (held != textures.end())
+        {
+            batch[i] = held->second;
+            hits++;
+        }
+        else if (first.count(keys[i]) > 0)
+            hits++;
+        else
+        {
+            batch[i] = std::make_shared<GLTexture>(GLTexture::create());
+            first[keys[i]] = i;
+            if (KtxFile::isKtx(paths[i].c_str()))
+                compressed.push_back(i);
+            else
+                submitted[decoder.submit(paths[i], settings.flip, settings.components,
+                                         mipmapFilter(settings, paths[i].c_str()),
+                                         settings.diskCache)] = i;
+            decodes++;
+        }
+    }
+
+    // KTX files only need reading, so upload them while the images decode
+    for (size_t k = 0; k < compressed.size(); k++)
+    {
+        size_t i = compressed[k];
+        CompressedTexture image;
+        if (!KtxFile::read(paths[i].c_str(), image))
+        {
+            printf("Texture %s failed to load.\n", paths[i].c_str());
+            continue;
+        }
+        uploadCompressed(*batch[i], image, settings);
+        textures[keys[i]] = batch[i];
+    }
+
+    // Upload each image as soon as it is decoded, while the rest decode
+    unsigned int id;
+    DecodedImage image;
+    while (decoder.next(id, image, true))
+    {
+        size_t i = submitted[id];
+        if (!image.pixels)
+        {
+            printf("Texture %s failed to load.\n", paths[i].c_str());
+            continue;
+        }
+        uploadImage(*batch[i], image, settings);
+        textures[keys[i]] = batch[i];
+    }
+
+    std::vector<TextureHandle> handles(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        const std::shared_ptr<GLTexture> &texture = batch[i] ? batch[i] : batch[first[keys[i]]];
+        handles[i] = TextureHandle(texture, &texture->id());
+    }
+    return handles;
+}
+
+bool TextureCache::read(const char *path, const TextureSettings &settings, TextureData &data)
+{
+    // KTX files are read as they are stored
+    if (KtxFile::isKtx(path))
+        return KtxFile::read(path, data.compressed);
+
+    data.image = ImageDecoder::decode(path, settings.flip, settings.components, mipmapFilter(settings, path),
+                                      settings.diskCache);
+    return data.image.pixels != NULL;
+}
+
+bool TextureCache::read(const unsigned char *file, size_t size, const TextureSettings &settings, TextureData &data)
+{
+    data.image = ImageDecoder::decode(file, size, settings.flip, settings.components, mipmapFilter(settings, NULL));
+    return data.image.pixels != NULL;
+}
+
+void TextureCache::upload(GLTexture &texture, const TextureData &data, const TextureSettings &settings)
+{
+    if (data.image.pixels)
+        uploadImage(texture, data.image, settings);
+    else if (!data.compressed.levels.empty())
+        uploadCompressed(texture, data.compressed, settings);
+}
+
+size_t TextureCache::size(const char *path, const TextureSettings &settings) const
+{
+    std::map<std::string, std::shared_ptr<GLTexture> >::const_iterator held = textures.find(key(path, settings));
+    return held != textures.end() ? held->second->size() : 0;
+}
+
+unsigned int TextureCache::evict(const char *path, const TextureSettings &settings)
+{
+    return static_cast<unsigned int>(textures.erase(key(path, settings)));
+}
+
+unsigned int TextureCache::evict(const char *path)
+{
+    std::string prefix = canonicalPath(path) + "|";
+    std::map<std::string, std::shared_ptr<GLTexture> >::iterator it = textures.lower_bound(prefix);
+    unsigned int evicted = 0;
+    while (it != textures.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+    {
+        textures.erase(it++);
+        evicted++;
+    }
+    return evicted;
+}
+
+unsigned int TextureCache::evictUnused()
+{
+    unsigned int evicted = 0;
+    for (std::map<std::string, std::shared_ptr<GLTexture> >::iterator it = textures.begin(); it != textures.end(); )
+    {
+        if (it->second.use_count() == 1)
+        {
+            textures.erase(it++);
+            evicted++;
+        }
+        else
+            ++it;
+    }
+    return evicted;
+}
+
+void TextureCache::clear()
+{
+    textures.clear();
+}
+
+TextureCacheStats TextureCache::stats() const
+{
+    TextureCacheStats stats;
+    stats.textures = static_cast<unsigned int>(textures.size());
+    stats.decodes  = decodes;
+    stats.hits     = hits;
+    stats.memory   = 0;
+    for (std::map<std::string, std::shared_ptr<GLTexture> >::const_iterator it = textures.begin(); it != textures.end(); ++it)
+        stats.memory += it->second->size();
+    return stats;
+}
+
+void TextureCache::report() const
+{
+    TextureCacheStats total = stats();
+    printf("%u textures, %.2f MB (%u decodes, %u shared)\n", total.textures, total.memory / 1048576.0,
+           total.decodes, total.hits);
+    for (std::map<std::string, std::shared_ptr<GLTexture> >::const_iterator it = textures.begin(); it != textures.end(); ++it)
+        printf("    %8.1f KB  %ld handles  %s\n", it->second->size() / 1024.0, it->second.use_count() - 1, it->first.c_str());
+    ImageCache::report();
+}
+
+std::string TextureCache::key(const char *path, const TextureSettings &settings)
+{
+    std::ostringstream key;
+    key << canonicalPath(path) << "|" << settings.components << "," << settings.flip << ","
+        << settings.wrap << "," << settings.minFilter << "," << settings.magFilter << "," << settings.mipmapFilter;
+    return key.str();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <common/globject.hpp>
+#include <common/imagedecoder.hpp>
+#include <common/ktx.hpp>
+#include <common/mipmaps.hpp>
+
+// Shared texture, dereferenced for the texture id. The texture is deleted
+// when the last handle goes.
+typedef std::shared_ptr<const unsigned int> TextureHandle;
+
+// How a texture is decoded and sampled. KTX files are uploaded as they were
+// stored by texcompress (flipped, with their own mip levels), so only the
+// sampler state applies to them.
+struct TextureSettings
+{
+    // Channels to decode to (0 keeps the channels of the file)
+    int components = 0;
+
+    // Flip the image so its first row is at the bottom, as OpenGL expects
+    // and as texture co-ordinates from .obj files assume. Only images
+    // sampled with co-ordinates starting at the top (as in .glb files)
+    // should turn this off.
+    bool flip = true;
+
+    // Sampler state (mipmaps are made if minFilter uses them)
+    GLenum wrap      = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+
+    // How mipmaps are made. Except with MipmapDriver they are built with the
+    // decode, off the GL thread for batches, and every level is uploaded.
+    // By default the filter is picked from the file name as texcompress
+    // does, so *normal* files get MipmapNormal, *specular* files MipmapBox
+    // and other files MipmapSrgb. Set it for files named otherwise.
+    MipmapFilter mipmapFilter = MipmapByName;
+
+    // Keep the decoded pixels and mip levels in an ImageCache file, in
+    // ImageCache::directory(), so later runs map them rather than decoding
+    // the image. Off by default, as the files are the size of the pixels.
+    bool diskCache = false;
+};
+
+// Image read for a texture and waiting to be uploaded: either the decoded
+// pixels (and mip levels if they were built) or a KTX file's levels
+struct TextureData
+{
+    DecodedImage      image;
+    CompressedTexture compressed;
+};
+
+// Counts kept by a TextureCache
+struct TextureCacheStats
+{
+    unsigned int textures;      // textures held
+    unsigned int decodes;       // images decoded and KTX files read
+    unsigned int hits;          // requests that shared a held texture
+    size_t       memory;        // bytes of GPU memory held
+};
+
+// Textures keyed by canonical path and settings. Requests for a file with
+// the same settings share one texture, which the cache holds until it is
+// evicted and is deleted once the last handle to it has gone too. Use on the
+// GL thread only.
+class TextureCache
+{
+public:
+    TextureCache();
+
+    // Cache used by loadTexture() and Model::addTexture(). It lives until
+    // exit, after the context has gone, so clear() it before glfwTerminate().
+    static TextureCache &shared();
+
+    // Get a texture, decoding and uploading the file if it isn't held. KTX
+    // files are uploaded block compressed.
+    TextureHandle get(const char *path, const TextureSettings &settings = TextureSettings());
+
+    // Get several textures, decoding the files that aren't held in parallel
+    // on the shared thread pool and uploading each one as it is decoded
+    std::vector<TextureHandle> get(const std::vector<std::string> &paths,
+                                   const TextureSettings &settings = TextureSettings());
+
+    // Read a file for a texture as get() does, without uploading it or
+    // holding it, returning false if it can't be read. Safe on any thread,
+    // so loaders can read on workers and upload() on the GL thread.
+    static bool read(const char *path, const TextureSettings &settings, TextureData &data);
+
+    // Decode an image held in memory, e.g. one embedded in a .glb file
+    static bool read(const unsigned char *file, size_t size, const TextureSettings &settings, TextureData &data);
+
+    // Upload what read() returned into a texture, replacing anything it held
+    static void upload(GLTexture &texture, const TextureData &data, const TextureSettings &settings);
+
+    // Bytes of GPU memory taken by a held texture (0 if it isn't held)
+    size_t size(const char *path, const TextureSettings &settings = TextureSettings()) const;
+
+    // Stop holding a texture, or every texture of a file, returning how
+    // many were dropped. Ids from loadTexture() are deleted with them.
+    unsigned int evict(const char *path, const TextureSettings &settings);
+    unsigned int evict(const char *path);
+
+    // Stop holding the textures that only the cache uses, returning how many
+    // were dropped
+    unsigned int evictUnused();
+
+    // Stop holding every texture
+    void clear();
+
+    // Current counts
+    TextureCacheStats stats() const;
+
+    // Print the held textures and their sizes, and how the ImageCache did
+    void report() const;
+
+private:
+    std::map<std::string, std::shared_ptr<GLTexture> > textures;    // by path|settings
+    unsigned int decodes, hits;
+
+    // Key of a file and settings (the canonical path comes first, so all
+    // the settings of a file sort together)
+    static std::string key(const char *path, const TextureSettings &settings);
+
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+};
@@ -0,0 +1,106 @@
+#include <atomic>
+#include <memory>
+
+#include <common/threadpool.hpp>
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    stopping = false;
+
+    if (numThreads == 0)
+        numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+
+    for (unsigned int i = 0; i < numThreads; i++)
+        workers.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)> &task)
+{
+    if (count == 0)
+        return;
+
+    // Shared between the caller and the helpers, which may outlive this call
+    // if they are still queued behind other work when the caller finishes
+    struct State
+    {
+        std::atomic<unsigned int> next;
+        std::atomic<unsigned int> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+        const std::function<void(unsigned int)> *task;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->next = 0;
+    state->done = 0;
+    state->task = &task;
+
+    // Claim indices until there are none left
+    auto work = [state, count]()
+    {
+        unsigned int i;
+        while ((i = state->next++) < count)
+        {
+            (*state->task)(i);
+            if (++state->done == count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    // Wake helpers and work on the calling thread too
+    unsigned int helpers = count - 1 < size() ? count - 1 : size();
+    for (unsigned int i = 0; i < helpers; i++)
+        submit(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == count; });
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
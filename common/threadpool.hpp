@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed size pool of worker threads
+class ThreadPool
+{
+public:
+    // Constructor (0 threads means one per hardware thread)
+    ThreadPool(unsigned int numThreads = 0);
+
+    // Destructor finishes queued tasks and joins the workers
+    ~ThreadPool();
+
+    // Queue a task to run on a worker
+    void submit(std::function<void()> task);
+
+    // Run task(0) ... task(count - 1) on the workers and the calling thread,
+    // returning once every index has been processed. Safe to call from a task.
+    void parallelFor(unsigned int count, const std::function<void(unsigned int)> &task);
+
+    // Number of worker threads
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // Pool shared by the loaders in common/
+    static ThreadPool &shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    // Worker thread loop
+    void run();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+};
@@ -0,0 +1,372 @@
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include <glm/gtc/packing.hpp>
+
+#include <common/vertexformat.hpp>
+
+namespace
+{
+    inline float fromSnorm(int q, int bits)
+    {
+        float scale = float((1 << (bits - 1)) - 1);
+        return glm::max(q / scale, -1.0f);
+    }
+
+    // Octahedral encode a unit vector, trying each way of rounding the two
+    // components and keeping the one that decodes closest to the input
+    void octQuantise(const glm::vec3 &n, int bits, int &qx, int &qy)
+    {
+        glm::vec2 e = VertexEncoder::octEncode(n);
+        float scale = float((1 << (bits - 1)) - 1);
+        int fx = static_cast<int>(std::floor(e.x * scale));
+        int fy = static_cast<int>(std::floor(e.y * scale));
+
+        float best = -2.0f;
+        for (int i = 0; i < 4; i++)
+        {
+            int x = glm::clamp(fx + (i & 1), -int(scale), int(scale));
+            int y = glm::clamp(fy + (i >> 1), -int(scale), int(scale));
+            float d = glm::dot(n, VertexEncoder::octDecode(glm::vec2(fromSnorm(x, bits), fromSnorm(y, bits))));
+            if (d > best)
+            {
+                best = d;
+                qx   = x;
+                qy   = y;
+            }
+        }
+    }
+
+    // Source value of an attribute, or false if there is no data for it
+    bool sourceValue(const VertexStreams &streams, VertexAttribute attribute,
+                     unsigned int i, glm::vec4 &value)
+    {
+        switch (attribute)
+        {
+            case AttributePosition:
+                if (streams.positions == NULL)
+                    return false;
+                value = glm::vec4((*streams.positions)[i], 0.0f);
+                return true;
+            case AttributeUV:
+                if (streams.uvs == NULL)
+                    return false;
+                value = glm::vec4((*streams.uvs)[i], 0.0f, 0.0f);
+                return true;
+            case AttributeNormal:
+                if (streams.normals == NULL)
+                    return false;
+                value = glm::vec4((*streams.normals)[i], 0.0f);
+                return true;
+            case AttributeTangent:
+                if (streams.tangents == NULL)
+                    return false;
+                value = (*streams.tangents)[i];
+                return true;
+            case AttributeBitangent:
+                if (streams.bitangents == NULL)
+                    return false;
+                value = glm::vec4((*streams.bitangents)[i], 0.0f);
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+VertexLayout &VertexLayout::add(VertexAttribute attribute, AttributeFormat format)
+{
+    VertexElement element;
+    element.attribute = attribute;
+    element.format    = format;
+    element.offset    = vertexStride;
+    vertexElements.push_back(element);
+    vertexStride += size(format);
+    return *this;
+}
+
+VertexLayout VertexLayout::standard()
+{
+    VertexLayout layout;
+    layout.add(AttributePosition, FormatFloat3)
+          .add(AttributeUV,       FormatFloat2)
+          .add(AttributeNormal,   FormatFloat3);
+    return layout;
+}
+
+VertexLayout VertexLayout::compact()
+{
+    VertexLayout layout;
+    layout.add(AttributePosition, FormatUnorm16x3)
+          .add(AttributeUV,       FormatHalf2)
+          .add(AttributeNormal,   FormatOct16);
+    return layout;
+}
+
+VertexLayout VertexLayout::positionsOf(const VertexLayout &layout)
+{
+    const VertexElement *position = layout.find(AttributePosition);
+    VertexLayout result;
+    result.add(AttributePosition, position != NULL ? position->format : FormatFloat3);
+    return result;
+}
+
+const VertexElement *VertexLayout::find(VertexAttribute attribute) const
+{
+    for (size_t i = 0; i < vertexElements.size(); i++)
+        if (vertexElements[i].attribute == attribute)
+            return &vertexElements[i];
+    return NULL;
+}
+
+unsigned int VertexLayout::code() const
+{
+    // Attribute and format of each element in 3 + 4 bits, so up to 4 elements
+    // fit in the code exactly; longer layouts are mixed in
+    unsigned int result = static_cast<unsigned int>(vertexElements.size());
+    for (size_t i = 0; i < vertexElements.size(); i++)
+        result = result * 128u + (vertexElements[i].attribute << 4 | vertexElements[i].format);
+    return result;
+}
+
+void VertexLayout::apply() const
+{
+    for (unsigned int location = 0; location < AttributeCount; location++)
+        glDisableVertexAttribArray(location);
+
+    for (size_t i = 0; i < vertexElements.size(); i++)
+    {
+        const VertexElement &element = vertexElements[i];
+        const void *offset = (const void*)(size_t)element.offset;
+        GLuint location = element.attribute;
+        glEnableVertexAttribArray(location);
+        switch (element.format)
+        {
+            case FormatFloat2:    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, vertexStride, offset); break;
+            case FormatFloat3:    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, vertexStride, offset); break;
+            case FormatFloat4:    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, vertexStride, offset); break;
+            case FormatHalf2:     glVertexAttribPointer(location, 2, GL_HALF_FLOAT, GL_FALSE, vertexStride, offset); break;
+            case FormatHalf4:     glVertexAttribPointer(location, 4, GL_HALF_FLOAT, GL_FALSE, vertexStride, offset); break;
+            case FormatUnorm16x3: glVertexAttribPointer(location, 3, GL_UNSIGNED_SHORT, GL_TRUE, vertexStride, offset); break;
+            case FormatOct16:     glVertexAttribPointer(location, 2, GL_SHORT, GL_TRUE, vertexStride, offset); break;
+            case FormatOct8:      glVertexAttribPointer(location, 2, GL_BYTE, GL_TRUE, vertexStride, offset); break;
+            case FormatOctTangent16: glVertexAttribPointer(location, 3, GL_SHORT, GL_TRUE, vertexStride, offset); break;
+        }
+    }
+}
+
+void VertexLayout::apply(const std::vector<VertexPointer> &pointers)
+{
+    for (unsigned int location = 0; location < AttributeCount; location++)
+        glDisableVertexAttribArray(location);
+
+    for (size_t i = 0; i < pointers.size(); i++)
+    {
+        const VertexPointer &pointer = pointers[i];
+        glEnableVertexAttribArray(pointer.attribute);
+        glVertexAttribPointer(pointer.attribute, pointer.components, pointer.type, pointer.normalised,
+                              pointer.stride, (const void*)pointer.offset);
+    }
+}
+
+unsigned int VertexLayout::size(AttributeFormat format)
+{
+    switch (format)
+    {
+        case FormatFloat2:    return 8;
+        case FormatFloat3:    return 12;
+        case FormatFloat4:    return 16;
+        case FormatHalf2:     return 4;
+        case FormatHalf4:     return 8;
+        case FormatUnorm16x3: return 8;
+        case FormatOct16:     return 4;
+        case FormatOct8:      return 4;
+        case FormatOctTangent16: return 8;
+    }
+    return 0;
+}
+
+VertexError VertexEncoder::encode(const VertexLayout &layout, const VertexStreams &streams,
+                                  unsigned int vertexCount,
+                                  const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                                  std::vector<unsigned char> &data)
+{
+    VertexError error = { 0.0f, 0.0f, 0.0f };
+    unsigned int stride = layout.stride();
+    data.assign(size_t(vertexCount) * stride, 0);
+
+    glm::vec3 extent = boundsMax - boundsMin;
+    float minCosine = 1.0f;
+    for (size_t e = 0; e < layout.elements().size(); e++)
+    {
+        const VertexElement &element = layout.elements()[e];
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            glm::vec4 value;
+            if (!sourceValue(streams, element.attribute, i, value))
+                break;
+
+            unsigned char *out = &data[size_t(i) * stride + element.offset];
+            switch (element.format)
+            {
+                case FormatFloat2:
+                case FormatFloat3:
+                case FormatFloat4:
+                    memcpy(out, &value[0], VertexLayout::size(element.format));
+                    break;
+
+                case FormatHalf2:
+                case FormatHalf4:
+                {
+                    uint16_t q[4];
+                    unsigned int components = element.format == FormatHalf2 ? 2 : 4;
+                    for (unsigned int k = 0; k < components; k++)
+                    {
+                        q[k] = glm::packHalf1x16(value[k]);
+                        if (element.attribute == AttributeUV)
+                            error.uv = glm::max(error.uv, std::fabs(glm::unpackHalf1x16(q[k]) - value[k]));
+                    }
+                    memcpy(out, q, 2 * components);
+                    break;
+                }
+
+                case FormatUnorm16x3:
+                {
+                    uint16_t q[4] = { 0, 0, 0, 0 };
+                    for (int k = 0; k < 3; k++)
+                    {
+                        float t = extent[k] > 0.0f ? (value[k] - boundsMin[k]) / extent[k] : 0.0f;
+                        q[k] = static_cast<uint16_t>(std::floor(glm::clamp(t, 0.0f, 1.0f) * 65535.0f + 0.5f));
+                        float decoded = boundsMin[k] + q[k] / 65535.0f * extent[k];
+                        if (element.attribute == AttributePosition)
+                            error.position = glm::max(error.position, std::fabs(decoded - value[k]));
+                    }
+                    memcpy(out, q, sizeof(q));
+                    break;
+                }
+
+                case FormatOct16:
+                case FormatOct8:
+                case FormatOctTangent16:
+                {
+                    glm::vec3 v(value);
+                    float length = glm::length(v);
+                    glm::vec3 n = length > 0.0f ? v / length : glm::vec3(0.0f, 0.0f, 1.0f);
+                    int bits = element.format == FormatOct8 ? 8 : 16;
+                    int qx = 0, qy = 0;
+                    octQuantise(n, bits, qx, qy);
+                    if (element.attribute == AttributeNormal)
+                    {
+                        glm::vec3 decoded = octDecode(glm::vec2(fromSnorm(qx, bits), fromSnorm(qy, bits)));
+                        minCosine = glm::min(minCosine, glm::dot(decoded, n));
+                    }
+
+                    if (element.format == FormatOctTangent16)
+                    {
+                        int16_t q[4] = { static_cast<int16_t>(qx), static_cast<int16_t>(qy),
+                                         static_cast<int16_t>(value.w < 0.0f ? -32767 : 32767), 0 };
+                        memcpy(out, q, sizeof(q));
+                    }
+                    else if (bits == 16)
+                    {
+                        int16_t q[2] = { static_cast<int16_t>(qx), static_cast<int16_t>(qy) };
+                        memcpy(out, q, sizeof(q));
+                    }
+                    else
+                    {
+                        int8_t q[2] = { static_cast<int8_t>(qx), static_cast<int8_t>(qy) };
+                        memcpy(out, q, sizeof(q));
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    error.normal = glm::degrees(std::acos(glm::clamp(minCosine, -1.0f, 1.0f)));
+
+    return error;
+}
+
+void VertexEncoder::extract(const VertexLayout &layout, VertexAttribute attribute,
+                            const void *vertexData, unsigned int vertexCount,
+                            std::vector<unsigned char> &data)
+{
+    const VertexElement *element = layout.find(attribute);
+    if (element == NULL)
+    {
+        data.clear();
+        return;
+    }
+
+    unsigned int size = VertexLayout::size(element->format);
+    data.resize(size_t(vertexCount) * size);
+    const unsigned char *in = static_cast<const unsigned char *>(vertexData) + element->offset;
+    for (unsigned int i = 0; i < vertexCount; i++)
+        memcpy(&data[size_t(i) * size], in + size_t(i) * layout.stride(), size);
+}
+
+void VertexEncoder::decodePositions(const VertexLayout &layout, const void *vertexData,
+                                    unsigned int vertexCount,
+                                    const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                                    std::vector<glm::vec3> &positions)
+{
+    positions.assign(vertexCount, glm::vec3(0.0f));
+    const VertexElement *element = layout.find(AttributePosition);
+    if (element == NULL)
+        return;
+
+    const unsigned char *in = static_cast<const unsigned char *>(vertexData) + element->offset;
+    for (unsigned int i = 0; i < vertexCount; i++, in += layout.stride())
+    {
+        switch (element->format)
+        {
+            case FormatFloat3:
+            case FormatFloat4:
+                memcpy(&positions[i][0], in, sizeof(glm::vec3));
+                break;
+
+            case FormatHalf4:
+            {
+                uint16_t q[4];
+                memcpy(q, in, sizeof(q));
+                for (int k = 0; k < 3; k++)
+                    positions[i][k] = glm::unpackHalf1x16(q[k]);
+                break;
+            }
+
+            case FormatUnorm16x3:
+            {
+                uint16_t q[4];
+                memcpy(q, in, sizeof(q));
+                for (int k = 0; k < 3; k++)
+                    positions[i][k] = boundsMin[k] + q[k] / 65535.0f * (boundsMax[k] - boundsMin[k]);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+glm::vec2 VertexEncoder::octEncode(const glm::vec3 &n)
+{
+    glm::vec2 e = glm::vec2(n.x, n.y) / (std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+    if (n.z < 0.0f)
+    {
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(e.y, e.x)));
+        e.x = e.x >= 0.0f ? folded.x : -folded.x;
+        e.y = e.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return e;
+}
+
+glm::vec3 VertexEncoder::octDecode(const glm::vec2 &e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    float t = glm::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Vertex attributes, numbered by their shader location
+enum VertexAttribute
+{
+    AttributePosition  = 0,
+    AttributeUV        = 1,
+    AttributeNormal    = 2,
+    AttributeTangent   = 3,
+    AttributeBitangent = 4,
+    AttributeCount     = 5
+};
+
+// Storage formats of a vertex attribute
+enum AttributeFormat
+{
+    FormatFloat2,       // 2 x float
+    FormatFloat3,       // 3 x float
+    FormatFloat4,       // 4 x float
+    FormatHalf2,        // 2 x half float
+    FormatHalf4,        // 4 x half float
+    FormatUnorm16x3,    // positions quantised within the bounding box, padded to 8 bytes
+    FormatOct16,        // unit vectors octahedral encoded in 2 x snorm16
+    FormatOct8,         // unit vectors octahedral encoded in 2 x snorm8, padded to 4 bytes
+    FormatOctTangent16  // tangents octahedral encoded in 2 x snorm16 with the sign of w in a
+                        // third, padded to 8 bytes
+};
+
+// One attribute of an interleaved vertex
+struct VertexElement
+{
+    VertexAttribute attribute;
+    AttributeFormat format;
+    unsigned int    offset;
+};
+
+// Attribute read from a buffer in the format it was stored in, for vertex
+// data that is uploaded as it is rather than interleaved and encoded
+struct VertexPointer
+{
+    VertexAttribute attribute;
+    GLint           components;
+    GLenum          type;
+    GLboolean       normalised;
+    GLsizei         stride;
+    size_t          offset;
+};
+
+// Description of an interleaved vertex: which attributes it holds, in what
+// format and where. Elements are 4-byte aligned in the order they are added.
+class VertexLayout
+{
+public:
+    // Append an attribute
+    VertexLayout &add(VertexAttribute attribute, AttributeFormat format);
+
+    // Position, uv and normal as floats (32 bytes)
+    static VertexLayout standard();
+
+    // Position, uv and normal quantised to 16 bytes
+    static VertexLayout compact();
+
+    // Position only, in the format used by another layout
+    static VertexLayout positionsOf(const VertexLayout &layout);
+
+    // Elements and vertex size
+    const std::vector<VertexElement> &elements() const { return vertexElements; }
+    unsigned int stride() const { return vertexStride; }
+
+    // Find the element for an attribute (NULL if the layout doesn't have it)
+    const VertexElement *find(VertexAttribute attribute) const;
+
+    // Unique number for the layout, used to key caches
+    unsigned int code() const;
+
+    // Point the attributes of the bound VAO into the bound array buffer,
+    // disabling attributes the layout doesn't have
+    void apply() const;
+
+    // Point the attributes of the bound VAO the same way for attributes
+    // stored as they are
+    static void apply(const std::vector<VertexPointer> &pointers);
+
+    // Size of an attribute in bytes, including padding
+    static unsigned int size(AttributeFormat format);
+
+private:
+    std::vector<VertexElement> vertexElements;
+    unsigned int vertexStride = 0;
+};
+
+// Source data for each attribute (NULL for attributes there is no data for)
+struct VertexStreams
+{
+    const std::vector<glm::vec3> *positions  = NULL;
+    const std::vector<glm::vec2> *uvs        = NULL;
+    const std::vector<glm::vec3> *normals    = NULL;
+    const std::vector<glm::vec4> *tangents   = NULL;
+    const std::vector<glm::vec3> *bitangents = NULL;
+};
+
+// Largest differences between encoded vertices and the float originals
+struct VertexError
+{
+    float position;    // in model units
+    float uv;
+    float normal;      // in degrees
+};
+
+// Packing of vertex attributes into VertexLayouts
+class VertexEncoder
+{
+public:
+    // Interleave and encode vertexCount vertices, quantising positions within
+    // the bounding box, and measure the error introduced. Attributes with no
+    // source data are filled with zeros.
+    static VertexError encode(const VertexLayout &layout, const VertexStreams &streams,
+                              unsigned int vertexCount,
+                              const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                              std::vector<unsigned char> &data);
+
+    // Copy one attribute out of interleaved vertex data into a layout of its own
+    static void extract(const VertexLayout &layout, VertexAttribute attribute,
+                        const void *vertexData, unsigned int vertexCount,
+                        std::vector<unsigned char> &data);
+
+    // Decode the positions of encoded vertex data (zeros if it has none)
+    static void decodePositions(const VertexLayout &layout, const void *vertexData,
+                                unsigned int vertexCount,
+                                const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                                std::vector<glm::vec3> &positions);
+
+    // Octahedral mapping of unit vectors to [-1, 1]^2 and back
+    static glm::vec2 octEncode(const glm::vec3 &n);
+    static glm::vec3 octDecode(const glm::vec2 &e);
+};
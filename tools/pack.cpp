@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <common/archive.hpp>
+
+// Pack assets into an archive the labs mount at startup, e.g. from a lab's
+// directory, so the names match the paths the lab loads:
+//
+//     pack -c assets.pak vertexShader.glsl fragmentShader.glsl ../assets/teapot.obj
+int main(int argc, char *argv[])
+{
+    bool compress = false;
+    unsigned int blockSize = 256 * 1024;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-c") == 0)
+            compress = true;
+        else if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+            blockSize = static_cast<unsigned int>(atoi(argv[++arg])) * 1024;
+        else
+            break;
+    }
+    if (argc - arg < 2)
+    {
+        printf("Usage: pack [-c] [-b blockKB] archive files...\n"
+               "  -c  compress files in blocks where it saves space\n"
+               "  -b  uncompressed block size in KB (default 256)\n");
+        return 1;
+    }
+
+    // Pack the files
+    const char *path = argv[arg];
+    std::vector<std::string> files(argv + arg + 1, argv + argc);
+    if (!AssetArchive::pack(path, files, compress, blockSize))
+    {
+        printf("Couldn't write %s.\n", path);
+        return 1;
+    }
+
+    // List what went in
+    AssetArchive archive;
+    if (!archive.open(path))
+    {
+        printf("%s was written but can't be read back.\n", path);
+        return 1;
+    }
+    unsigned long long size = 0, storedSize = 0;
+    for (unsigned int i = 0; i < archive.entryCount(); i++)
+    {
+        const ArchiveEntry &entry = archive.entry(i);
+        printf("%10llu %10llu %s%s\n", (unsigned long long)entry.size, (unsigned long long)entry.storedSize,
+               archive.name(entry), entry.blockCount > 0 ? " (compressed)" : "");
+        size       += entry.size;
+        storedSize += entry.storedSize;
+    }
+    printf("%u files, %.2f MB packed into %.2f MB\n", archive.entryCount(), size / 1048576.0, storedSize / 1048576.0);
+    return 0;
+}
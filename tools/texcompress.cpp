@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <common/blockcompression.hpp>
+#include <common/imagedecoder.hpp>
+#include <common/ktx.hpp>
+#include <common/mipmaps.hpp>
+
+namespace
+{
+    // What a texture is sampled for, which decides its format
+    enum TextureUsage
+    {
+        UsageDiffuse,
+        UsageSpecular,
+        UsageNormal
+    };
+
+    const char *usageNames[] = { "diffuse", "specular", "normal" };
+
+    double milliseconds(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    // Usage from the file name, as the assets are named
+    TextureUsage usageOf(const std::string &path)
+    {
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+        if (name.find("normal") != std::string::npos)
+            return UsageNormal;
+        if (name.find("specular") != std::string::npos)
+            return UsageSpecular;
+        return UsageDiffuse;
+    }
+}
+
+// Compress textures into KTX files of block compressed mip levels, written
+// next to each image with a .ktx extension, e.g. from the repository root:
+//
+//     texcompress assets/*.png assets/*.jpg assets/*.bmp
+//
+// Normal maps (named *normal*) are stored as BC5, keeping x and y for the
+// shader to rebuild z from. Other textures are BC1, or BC3 if they have any
+// transparency.
+int main(int argc, char *argv[])
+{
+    int forced = -1;
+    bool mipmaps = true;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc)
+        {
+            arg++;
+            for (int format = 0; format < BlockFormatCount; format++)
+            {
+                if (strcmp(argv[arg], BlockCompression::name(BlockFormat(format))) == 0)
+                    forced = format;
+            }
+            if (forced < 0)
+                break;
+        }
+        else if (strcmp(argv[arg], "-n") == 0)
+            mipmaps = false;
+        else
+            break;
+    }
+    if (arg >= argc)
+    {
+        printf("Usage: texcompress [-f BC1|BC3|BC5] [-n] images...\n"
+               "  -f  use this format rather than one chosen by usage\n"
+               "  -n  store only the full size image, without mip levels\n");
+        return 1;
+    }
+
+    printf("%-28s %9s %-8s %-4s %10s %10s %6s %9s %9s %9s\n", "texture", "size", "usage", "fmt", "RGBA8 KB",
+           "KTX KB", "ratio", "encode ms", "decode ms", "read ms");
+    size_t totalUncompressed = 0, totalCompressed = 0;
+    int failures = 0;
+    for (; arg < argc; arg++)
+    {
+        std::string path = argv[arg];
+
+        // Decode bottom row first, as loadTexture() does
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DecodedImage image = ImageDecoder::decode(path.c_str(), true, 4);
+        double decodeTime = milliseconds(start, std::chrono::steady_clock::now());
+        if (!image.pixels)
+        {
+            printf("%s couldn't be decoded\n", path.c_str());
+            failures++;
+            continue;
+        }
+
+        // Pick the format
+        TextureUsage usage = usageOf(path);
+        BlockFormat format = usage == UsageNormal ? BlockBC5 : BlockBC1;
+        size_t pixelCount = size_t(image.width) * image.height;
+        for (size_t i = 0; usage == UsageDiffuse && i < pixelCount; i++)
+        {
+            if (image.pixels.get()[4 * i + 3] < 255)
+            {
+                format = BlockBC3;
+                break;
+            }
+        }
+        if (forced >= 0)
+            format = BlockFormat(forced);
+
+        // Compress each level, downsampling from the one before
+        start = std::chrono::steady_clock::now();
+        CompressedTexture texture;
+        texture.format = format;
+        texture.width  = image.width;
+        texture.height = image.height;
+        std::vector<unsigned char> level(image.pixels.get(), image.pixels.get() + pixelCount * 4), next;
+        int width = image.width, height = image.height;
+        size_t uncompressed = 0;
+        while (true)
+        {
+            texture.levels.push_back(std::vector<unsigned char>());
+            BlockCompression::compress(&level[0], width, height, format, texture.levels.back());
+            uncompressed += size_t(width) * height * 4;
+            if (!mipmaps || (width == 1 && height == 1))
+                break;
+            next.resize(Mipmaps::levelSize(width, height, 4, 1));
+            Mipmaps::downsample(&level[0], width, height, 4, Mipmaps::filterFor(path.c_str()), &next[0]);
+            level.swap(next);
+            width  = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+        double encodeTime = milliseconds(start, std::chrono::steady_clock::now());
+
+        std::string output = path.substr(0, path.find_last_of('.')) + ".ktx";
+        if (!KtxFile::write(output.c_str(), texture))
+        {
+            printf("%s couldn't be written\n", output.c_str());
+            failures++;
+            continue;
+        }
+
+        // Time reading it back, which is all loading it takes before upload
+        start = std::chrono::steady_clock::now();
+        CompressedTexture check;
+        bool readBack = KtxFile::read(output.c_str(), check);
+        double readTime = milliseconds(start, std::chrono::steady_clock::now());
+        if (!readBack || KtxFile::size(check) != KtxFile::size(texture))
+        {
+            printf("%s was written but can't be read back\n", output.c_str());
+            failures++;
+            continue;
+        }
+
+        size_t compressed = KtxFile::size(texture);
+        char dimensions[32];
+        snprintf(dimensions, sizeof(dimensions), "%dx%d", image.width, image.height);
+        printf("%-28s %9s %-8s %-4s %10.1f %10.1f %5.1fx %9.1f %9.1f %9.2f\n",
+               path.substr(path.find_last_of("/\\") + 1).c_str(), dimensions, usageNames[usage],
+               BlockCompression::name(format), uncompressed / 1024.0, compressed / 1024.0,
+               double(uncompressed) / compressed, encodeTime, decodeTime, readTime);
+        totalUncompressed += uncompressed;
+        totalCompressed   += compressed;
+    }
+    if (totalCompressed > 0)
+        printf("%.2f MB of RGBA8 mip chains stored in %.2f MB (%.1fx smaller)\n", totalUncompressed / 1048576.0,
+               totalCompressed / 1048576.0, double(totalUncompressed) / totalCompressed);
+    return failures > 0 ? 1 : 0;
+}